@@ -0,0 +1,161 @@
+#include "adaptive_sweep.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	namespace {
+		std::complex<double> log_slope(const sweep_sample& s) { return s.omega * s.slope / s.impedance; } // d ln Z / d ln omega
+
+		double extremum_sign(const sweep_sample& s) // sign of d|Z|^2 / domega; zero where it cannot be told
+		{
+			double g = std::real(std::conj(s.impedance) * s.slope);
+			return std::isfinite(g) ? (g > 0) - (g < 0) : 0;
+		}
+
+		class sampler
+		{
+		private:
+			const flat_view& circuit;
+			const adaptive_sweep_options& options;
+			std::vector<std::complex<double>> stack;
+		public:
+			std::size_t evaluations{ 0 };
+
+			sampler(const flat_view& c, const adaptive_sweep_options& o) : circuit{ c }, options{ o } {}
+			bool exhausted() const { return evaluations >= options.max_evaluations; }
+			sweep_sample at(double omega) { evaluations++; return impedance_with_slope(circuit, omega, stack); }
+
+			bool smooth(const sweep_sample& a, const sweep_sample& middle, const sweep_sample& b) const
+			// whether the cubic through a and b (values and slopes of ln Z against ln omega) predicts middle closely enough
+			{
+				if (a.impedance == b.impedance && middle.impedance == a.impedance) { return true; } // flat, shorted or open throughout
+				double h = std::log(b.omega / a.omega);
+				std::complex<double> predicted = (std::log(a.impedance) + std::log(b.impedance)) / 2. + h * (log_slope(a) - log_slope(b)) / 8.;
+				std::complex<double> miss = predicted - std::log(middle.impedance);
+				return std::abs(miss.real()) <= std::log1p(options.magnitude_tolerance) && std::abs(miss.imag()) <= options.phase_tolerance; // false for NaN
+			}
+		};
+	}
+
+	sweep_sample impedance_with_slope(const flat_view& circuit, double omega, std::vector<std::complex<double>>& stack)
+	{
+		// forward-mode derivative alongside the usual evaluation: slots 2k and 2k + 1 hold Z and dZ/domega
+		stack.resize(2 * circuit.max_stack);
+		std::size_t top{ 0 };
+		for (std::size_t i = 0; i < circuit.size; i++) {
+			double c = circuit.characteristics[i];
+			switch (static_cast<unit_kind>(circuit.kinds[i])) {
+			case unit_kind::resistor: stack[2 * top] = { c, 0 }; stack[2 * top + 1] = {}; top++; break;
+			case unit_kind::inductor: stack[2 * top] = { 0, c * omega }; stack[2 * top + 1] = { 0, c }; top++; break;
+			case unit_kind::capacitor: stack[2 * top] = { 0, -1. / (c * omega) }; stack[2 * top + 1] = { 0, 1. / (c * omega * omega) }; top++; break;
+			case unit_kind::series: {
+				std::size_t first = top - circuit.arities[i]; std::complex<double> sum, slope;
+				for (std::size_t j = first; j < top; j++) { sum += stack[2 * j]; slope += stack[2 * j + 1]; }
+				top = first; stack[2 * top] = sum; stack[2 * top + 1] = slope; top++;
+				break;
+			}
+			case unit_kind::parallel: { // Z = 1 / sum(Y_k), so dZ/domega = -Z^2 sum(dY_k/domega) with dY/domega = -Z'/Z^2
+				std::size_t first = top - circuit.arities[i]; std::complex<double> sum, admittance_slope;
+				for (std::size_t j = first; j < top; j++) {
+					std::complex<double> z = stack[2 * j];
+					sum += 1. / z;
+					if (std::isfinite(z.real()) && std::isfinite(z.imag()) && z != std::complex<double>{}) { admittance_slope -= stack[2 * j + 1] / (z * z); }
+				}
+				std::complex<double> z = 1. / sum;
+				top = first; stack[2 * top] = z;
+				stack[2 * top + 1] = z == std::complex<double>{} ? std::complex<double>{} : -z * z * admittance_slope; // a short (R or L of zero) does not vary
+				top++;
+				break;
+			}
+			}
+		}
+		if (top == 0) { return { omega, {}, {} }; }
+		return { omega, stack[0], stack[1] };
+	}
+
+	std::complex<double> adaptive_sweep_result::interpolate(double omega) const
+	{
+		if (samples.empty()) { return {}; }
+		auto after = std::lower_bound(samples.begin(), samples.end(), omega, [](const sweep_sample& s, double w) { return s.omega < w; });
+		if (after == samples.end()) { return samples.back().impedance; }
+		if (after == samples.begin() || after->omega == omega) { return after->impedance; }
+		const sweep_sample& a = *(after - 1);
+		const sweep_sample& b = *after;
+		if (a.impedance == b.impedance) { return a.impedance; }
+		double h = std::log(b.omega / a.omega), t = std::log(omega / a.omega) / h;
+		double h00 = (1 + 2 * t) * (1 - t) * (1 - t), h10 = t * (1 - t) * (1 - t), h01 = t * t * (3 - 2 * t), h11 = t * t * (t - 1);
+		return std::exp(h00 * std::log(a.impedance) + h10 * h * log_slope(a) + h01 * std::log(b.impedance) + h11 * h * log_slope(b));
+	}
+
+	adaptive_sweep_result adaptive_sweep(const flat_view& circuit, const adaptive_sweep_options& options)
+	{
+		if (!(options.omega_min > 0 && options.omega_min < options.omega_max) || !std::isfinite(options.omega_max)) {
+			throw std::invalid_argument("adaptive_sweep: need 0 < omega_min < omega_max");
+		}
+		if (!(options.magnitude_tolerance > 0 && options.phase_tolerance > 0 && options.peak_precision > 0)) {
+			throw std::invalid_argument("adaptive_sweep: tolerances must be positive");
+		}
+		sampler evaluate(circuit, options);
+		adaptive_sweep_result result;
+
+		std::size_t initial = std::max<std::size_t>(options.initial_points, 2);
+		double span = std::log(options.omega_max / options.omega_min);
+		std::vector<sweep_sample> grid(initial);
+		for (std::size_t k = 0; k < initial; k++) {
+			double omega = k + 1 == initial ? options.omega_max : options.omega_min * std::exp(span * k / (initial - 1));
+			grid[k] = evaluate.at(omega);
+		}
+
+		// depth first, left half before right, so samples come out in order; each interval's middle is kept either way
+		struct interval { sweep_sample low, high; };
+		std::vector<interval> pending;
+		for (std::size_t k = initial - 1; k-- > 0;) { pending.push_back({ grid[k], grid[k + 1] }); }
+		while (!pending.empty()) {
+			interval span_now = pending.back();
+			pending.pop_back();
+			result.samples.push_back(span_now.low);
+			if (span_now.high.omega / span_now.low.omega - 1 <= options.peak_precision) { continue; }
+			if (evaluate.exhausted()) { result.complete = false; continue; }
+			sweep_sample middle = evaluate.at(std::sqrt(span_now.low.omega * span_now.high.omega));
+			if (evaluate.smooth(span_now.low, middle, span_now.high)) { result.samples.push_back(middle); continue; }
+			pending.push_back({ middle, span_now.high });
+			pending.push_back({ span_now.low, middle });
+		}
+		result.samples.push_back(grid.back());
+
+		// every sign change of d|Z|/domega between neighbours brackets a peak or dip; bisect it in log omega
+		std::vector<sweep_sample> extrema;
+		for (std::size_t k = 0; k + 1 < result.samples.size(); k++) {
+			double left = extremum_sign(result.samples[k]), right = extremum_sign(result.samples[k + 1]);
+			if (left == 0 || right == 0 || left == right) { continue; }
+			sweep_sample low = result.samples[k], high = result.samples[k + 1];
+			while (high.omega / low.omega - 1 > options.peak_precision) {
+				if (evaluate.exhausted()) { result.complete = false; break; }
+				sweep_sample middle = evaluate.at(std::sqrt(low.omega * high.omega));
+				double sign = extremum_sign(middle);
+				if (sign == 0) { low = high = middle; break; }
+				(sign == left ? low : high) = middle;
+			}
+			bool maximum = left > 0;
+			const sweep_sample& best = (std::abs(low.impedance) > std::abs(high.impedance)) == maximum ? low : high;
+			extrema.push_back(best);
+			result.resonances.push_back({ best.omega, best.impedance, maximum });
+		}
+		std::vector<sweep_sample> merged(result.samples.size() + extrema.size());
+		auto by_omega = [](const sweep_sample& a, const sweep_sample& b) { return a.omega < b.omega; };
+		std::merge(result.samples.begin(), result.samples.end(), extrema.begin(), extrema.end(), merged.begin(), by_omega);
+		merged.erase(std::unique(merged.begin(), merged.end(), [](const sweep_sample& a, const sweep_sample& b) { return a.omega == b.omega; }), merged.end());
+		result.samples.swap(merged);
+		result.evaluations = evaluate.evaluations;
+		return result;
+	}
+
+	adaptive_sweep_result adaptive_sweep(const unit& root, const adaptive_sweep_options& options)
+	{
+		flat_circuit flat(root);
+		return adaptive_sweep(flat.view(), options);
+	}
+}
@@ -0,0 +1,63 @@
+// header file for adaptive frequency sweeps. Instead of a fixed grid, samples are placed where the impedance curve bends:
+// each sample also carries dZ/domega (found in the same pass over the flattened tree), an interval is split whenever
+// the cubic through its two ends misses the value at its middle by more than the tolerance, and every peak and dip of
+// |Z| that the samples bracket is then pinned down by bisection. Interpolation is done on ln Z against ln omega, whose
+// real part is ln|Z| and whose imaginary part is the phase, so one test covers both tolerances.
+//
+// A feature far narrower than the initial spacing whose presence changes neither the values nor the slopes at the
+// nearest samples can still be missed; increase initial_points if the circuit has very high-Q resonances.
+#pragma once
+#ifndef adaptive_sweep_h
+#define adaptive_sweep_h
+
+#include <complex>
+#include <vector>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	struct adaptive_sweep_options
+	{
+		double omega_min{ 1 }, omega_max{ 1e6 }; // rad/s
+		double magnitude_tolerance{ 1e-3 }; // relative error allowed in |Z| when interpolating between samples
+		double phase_tolerance{ 1e-3 }; // radians
+		double peak_precision{ 1e-9 }; // relative precision of the resonance frequencies, and the closest samples get
+		std::size_t initial_points{ 17 }; // evenly spaced in log omega, ends included
+		std::size_t max_evaluations{ 1000000 }; // refinement stops here, and the result is marked incomplete
+	};
+
+	struct sweep_sample
+	{
+		double omega;
+		std::complex<double> impedance;
+		std::complex<double> slope; // dZ / domega
+	};
+
+	struct resonance
+	{
+		double omega;
+		std::complex<double> impedance;
+		bool maximum; // a peak of |Z| (anti-resonance) rather than a dip (resonance)
+	};
+
+	struct adaptive_sweep_result
+	{
+		std::vector<sweep_sample> samples; // in increasing omega; includes the located resonances
+		std::vector<resonance> resonances; // in increasing omega
+		std::size_t evaluations{ 0 };
+		bool complete{ true }; // false if max_evaluations cut the refinement short
+
+		std::complex<double> interpolate(double omega) const; // cubic Hermite in ln Z against ln omega; omega within the range swept
+	};
+
+	sweep_sample impedance_with_slope(const flat_view& circuit, double omega, std::vector<std::complex<double>>& stack);
+	// stack is scratch space, resized as needed; the impedance is the same to the last bit as flat_view::get_impedance
+
+	adaptive_sweep_result adaptive_sweep(const flat_view& circuit, const adaptive_sweep_options& options);
+	adaptive_sweep_result adaptive_sweep(const unit& root, const adaptive_sweep_options& options);
+	// throws std::invalid_argument unless 0 < omega_min < omega_max and the tolerances are positive
+}
+
+#endif
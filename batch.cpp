@@ -0,0 +1,230 @@
+#include "batch.h"
+#include "unit_class.h"
+#include "flat_circuit.h"
+#include "parallel_sweep.h"
+#include "mna_solver.h"
+#include "netlist.h"
+#include "buffered_writer.h"
+#include "thread_pool.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <charconv>
+#include <stdexcept>
+#include <cmath>
+
+namespace batch {
+
+	using namespace unit_namespace;
+
+	namespace {
+		enum class format { csv, json };
+
+		struct settings
+		{
+			std::string input;
+			bool network{ false };
+			double from{ 1 }, to{ 1e6 }; // rad/s
+			std::size_t points{ 101 };
+			bool linear{ false };
+			bool fast{ false }; // batched SIMD kernels: equal to get_impedance to rounding rather than bit for bit, exactly on shorts and opens
+			std::size_t threads{ 0 };
+			format output_format{ format::csv };
+			std::string output; // empty for standard output
+			bool dump{ false };
+			double at{ std::nan("") }; // dump frequency; --from if not given
+		};
+
+		constexpr std::size_t block_points{ 1 << 16 }; // frequencies evaluated, then written, at a time
+
+		void usage()
+		{
+			std::cerr << "usage: --batch <netlist | -> [--network] [--from omega] [--to omega] [--points n] [--linear] [--fast] [--threads n]\n"
+				"               [--format csv|json] [--output file] [--dump [--at omega]]" << std::endl;
+		}
+
+		settings parse_arguments(const std::vector<std::string>& arguments)
+		{
+			settings s;
+			auto value = [&](std::size_t& i) -> const std::string& {
+				if (i + 1 >= arguments.size()) { throw std::invalid_argument(arguments[i] + " needs a value"); }
+				return arguments[++i];
+			};
+			auto number = [&](std::size_t& i) {
+				const std::string& text = value(i);
+				std::size_t used{ 0 };
+				double x = std::stod(text, &used);
+				if (used != text.size() || !std::isfinite(x)) { throw std::invalid_argument("not a number: " + text); }
+				return x;
+			};
+			auto whole_number = [&](std::size_t& i) { // from_chars, so "-1", "1.5" and "1e30" are errors rather than casts
+				const std::string& text = value(i);
+				std::size_t n{ 0 };
+				auto parsed = std::from_chars(text.data(), text.data() + text.size(), n);
+				if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) { throw std::invalid_argument("not a whole number: " + text); }
+				return n;
+			};
+			for (std::size_t i = 0; i < arguments.size(); i++) {
+				const std::string& a = arguments[i];
+				if (a == "--network") { s.network = true; }
+				else if (a == "--from") { s.from = number(i); }
+				else if (a == "--to") { s.to = number(i); }
+				else if (a == "--points") { s.points = whole_number(i); }
+				else if (a == "--linear") { s.linear = true; }
+				else if (a == "--fast") { s.fast = true; }
+				else if (a == "--threads") { s.threads = whole_number(i); }
+				else if (a == "--format") {
+					const std::string& f = value(i);
+					if (f == "csv") { s.output_format = format::csv; }
+					else if (f == "json") { s.output_format = format::json; }
+					else { throw std::invalid_argument("unknown format: " + f); }
+				}
+				else if (a == "--output") { s.output = value(i); }
+				else if (a == "--dump") { s.dump = true; }
+				else if (a == "--at") { s.at = number(i); }
+				else if (s.input.empty() && (a == "-" || a.compare(0, 2, "--") != 0)) { s.input = a; }
+				else { throw std::invalid_argument("unexpected argument: " + a); }
+			}
+			if (s.input.empty()) { throw std::invalid_argument("no netlist given"); }
+			if (!(s.from > 0 && s.from <= s.to)) { throw std::invalid_argument("need 0 < --from <= --to"); }
+			if (s.points == 0) { throw std::invalid_argument("--points must be at least 1"); }
+			if (std::isnan(s.at)) { s.at = s.from; }
+			if (!(s.at > 0)) { throw std::invalid_argument("need --at > 0"); } // a capacitor at omega 0 is an open circuit, 1 / 0
+			if (s.dump && s.network) { throw std::invalid_argument("--dump needs a tree netlist, not --network"); }
+			return s;
+		}
+
+		double frequency(const settings& s, std::size_t k)
+		{
+			if (s.points == 1) { return s.from; }
+			if (k + 1 == s.points) { return s.to; }
+			double t = static_cast<double>(k) / static_cast<double>(s.points - 1);
+			return s.linear ? s.from + (s.to - s.from) * t : s.from * std::pow(s.to / s.from, t);
+		}
+
+		std::string read_all(std::istream& in) { return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()); }
+
+		void put_number(buffered_writer& out, double x, format f) // JSON has no inf or nan
+		{
+			if (f == format::json && !std::isfinite(x)) { out.put("null"); }
+			else { out.put(x); }
+		}
+
+		template <typename Evaluate> void write_sweep(buffered_writer& out, const settings& s, std::size_t circuit_number, Evaluate evaluate)
+		// evaluate(omegas) returns the impedances at a block of frequencies
+		{
+			bool json = s.output_format == format::json;
+			if (json) { out.put(circuit_number == 1 ? "\n{\"circuit\":" : ",\n{\"circuit\":"); out.put(circuit_number); out.put(",\"points\":["); }
+			std::vector<double> omegas;
+			for (std::size_t start = 0; start < s.points; start += block_points) {
+				std::size_t count = std::min(block_points, s.points - start);
+				omegas.resize(count);
+				for (std::size_t k = 0; k < count; k++) { omegas[k] = frequency(s, start + k); }
+				std::vector<std::complex<double>> z = evaluate(omegas);
+				for (std::size_t k = 0; k < count; k++) {
+					if (json) { out.put(start + k == 0 ? "\n[" : ",\n["); }
+					else { out.put(circuit_number); out.put(','); }
+					double values[5]{ omegas[k], z[k].real(), z[k].imag(), std::abs(z[k]), std::arg(z[k]) };
+					for (int v = 0; v < 5; v++) {
+						if (v > 0) { out.put(','); }
+						put_number(out, values[v], s.output_format);
+					}
+					out.put(json ? ']' : '\n');
+				}
+			}
+			if (json) { out.put("]}"); }
+		}
+
+		void write_nodes(buffered_writer& out, const settings& s, std::size_t circuit_number, const flat_circuit& flat)
+		// every node in postorder with its parent and its impedance, worked out with the same arithmetic as the evaluator
+		{
+			static const char* const kind_names[]{ "resistor", "inductor", "capacitor", "series", "parallel" };
+			bool json = s.output_format == format::json;
+			std::size_t n = flat.size();
+			std::vector<std::complex<double>> z(n);
+			std::vector<std::int64_t> parent(n, -1);
+			std::vector<std::size_t> stack;
+			for (std::size_t i = 0; i < n; i++) {
+				double c = flat.get_characteristic(i);
+				std::size_t first = stack.size() - flat.get_arity(i);
+				switch (flat.get_kind(i)) {
+				case unit_kind::resistor: z[i] = { c, 0 }; break;
+				case unit_kind::inductor: z[i] = { 0, c * s.at }; break;
+				case unit_kind::capacitor: z[i] = { 0, -1. / (c * s.at) }; break;
+				case unit_kind::series: { std::complex<double> sum; for (std::size_t j = first; j < stack.size(); j++) { sum += z[stack[j]]; } z[i] = sum; break; }
+				case unit_kind::parallel: { std::complex<double> sum; for (std::size_t j = first; j < stack.size(); j++) { sum += 1. / z[stack[j]]; } z[i] = 1. / sum; break; }
+				}
+				for (std::size_t j = first; j < stack.size(); j++) { parent[stack[j]] = static_cast<std::int64_t>(i); }
+				stack.resize(first);
+				stack.push_back(i);
+			}
+
+			if (json) {
+				out.put(circuit_number == 1 ? "\n{\"circuit\":" : ",\n{\"circuit\":"); out.put(circuit_number);
+				out.put(",\"omega\":"); put_number(out, s.at, s.output_format); out.put(",\"nodes\":[");
+			}
+			for (std::size_t i = 0; i < n; i++) {
+				unit_kind kind = flat.get_kind(i);
+				bool component = kind != unit_kind::series && kind != unit_kind::parallel;
+				if (json) { out.put(i == 0 ? "\n[" : ",\n["); }
+				else { out.put(circuit_number); out.put(','); }
+				out.put(i); out.put(','); out.put(parent[i]); out.put(',');
+				if (json) { out.put('"'); out.put(kind_names[static_cast<std::size_t>(kind)]); out.put('"'); }
+				else { out.put(kind_names[static_cast<std::size_t>(kind)]); }
+				out.put(',');
+				if (component) { put_number(out, flat.get_characteristic(i), s.output_format); }
+				else if (json) { out.put("null"); }
+				double values[4]{ z[i].real(), z[i].imag(), std::abs(z[i]), std::arg(z[i]) };
+				for (double v : values) { out.put(','); put_number(out, v, s.output_format); }
+				out.put(json ? ']' : '\n');
+			}
+			if (json) { out.put("]}"); }
+		}
+	}
+
+	int run(const std::vector<std::string>& arguments)
+	{
+		settings s;
+		try { s = parse_arguments(arguments); }
+		catch (const std::exception& e) { std::cerr << "batch: " << e.what() << std::endl; usage(); return 2; }
+
+		try {
+			std::string text;
+			if (s.input == "-") { text = read_all(std::cin); }
+			std::ofstream file;
+			if (!s.output.empty()) {
+				file.open(s.output, std::ios::binary);
+				if (!file) { throw std::runtime_error("cannot write " + s.output); }
+			}
+			std::ostream& stream = s.output.empty() ? std::cout : file;
+			thread_pool pool(s.threads);
+			sweep_options options;
+			options.vectorized = s.fast;
+			bool json = s.output_format == format::json;
+			{
+				buffered_writer out(stream);
+				if (s.network) {
+					mna_solver solver(s.input == "-" ? parse_network(text) : load_network(s.input));
+					out.put(json ? "{\"sweeps\":[" : "circuit,omega,real,imag,magnitude,phase\n");
+					write_sweep(out, s, 1, [&](const std::vector<double>& omegas) { return solver.sweep(omegas, pool); });
+				}
+				else {
+					std::vector<std::unique_ptr<unit>> units = s.input == "-" ? parse_netlist(text) : load_netlist(s.input);
+					if (s.dump) { out.put(json ? "{\"trees\":[" : "circuit,node,parent,kind,value,real,imag,magnitude,phase\n"); }
+					else { out.put(json ? "{\"sweeps\":[" : "circuit,omega,real,imag,magnitude,phase\n"); }
+					for (std::size_t c = 0; c < units.size(); c++) {
+						flat_circuit flat(*units[c]);
+						if (s.dump) { write_nodes(out, s, c + 1, flat); }
+						else { write_sweep(out, s, c + 1, [&](const std::vector<double>& omegas) { return parallel_sweep(flat.view(), omegas, pool, options); }); }
+					}
+				}
+				if (json) { out.put("\n]}\n"); }
+			}
+			stream.flush();
+			if (!stream) { throw std::runtime_error("writing the output failed"); }
+		}
+		catch (const std::exception& e) { std::cerr << "batch: " << e.what() << std::endl; return 1; }
+		return 0;
+	}
+}
@@ -0,0 +1,24 @@
+// header file for the non-interactive batch mode. It is run from the command line with
+//   --batch <netlist | -> [--network] [--from omega] [--to omega] [--points n] [--linear] [--fast] [--threads n]
+//           [--format csv|json] [--output file] [--dump [--at omega]]
+// The netlist (see netlist.h; "-" reads standard input) is swept from --from to --to rad/s (default 1 to 10^6, 101
+// points, logarithmically spaced unless --linear), every top-level item of a tree netlist separately, or the port of
+// a node netlist with --network. --fast uses the batched SIMD kernels for trees, which agree with get_impedance to
+// rounding rather than bit for bit (shorted members and open capacitors give exactly its values, not NaN). With --dump, every node of every tree is written instead, with its impedance at
+// --at rad/s (positive; default --from). Results go to --output (default standard output) as CSV or JSON.
+//
+// Frequencies are evaluated in blocks on the thread pool and each block is written out as soon as it is done, through a
+// large buffer with std::to_chars formatting, so memory stays flat and output runs at the speed of the disk.
+#pragma once
+#ifndef batch_h
+#define batch_h
+
+#include <vector>
+#include <string>
+
+namespace batch {
+
+	int run(const std::vector<std::string>& arguments); // returns the process exit code
+}
+
+#endif
@@ -0,0 +1,995 @@
+#include "benchmark.h"
+#include "unit_class.h"
+#include "flat_circuit.h"
+#include "fixed_circuit.h"
+#include "sweep.h"
+#include "parallel_sweep.h"
+#include "random_circuit.h"
+#include "rational_impedance.h"
+#include "circuit_dag.h"
+#include "mna_solver.h"
+#include "monte_carlo.h"
+#include "sensitivity.h"
+#include "adaptive_sweep.h"
+#include "transient.h"
+#include "instrument.h"
+#include "netlist.h"
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <optional>
+
+#ifdef UNIT_COUNT_ALLOCATIONS
+namespace {
+	std::atomic<std::size_t> allocations{ 0 };
+}
+
+// every heap allocation in the program is counted here. Only benchmark builds define UNIT_COUNT_ALLOCATIONS; other
+// builds keep the library's own operator new and pay nothing
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size)) { return p; }
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+using namespace unit_namespace;
+
+namespace bench {
+
+#ifdef UNIT_COUNT_ALLOCATIONS
+	bool counting_allocations() { return true; }
+	std::size_t allocation_count() { return allocations.load(std::memory_order_relaxed); }
+#else
+	bool counting_allocations() { return false; }
+	std::size_t allocation_count() { return 0; }
+#endif
+
+	namespace {
+
+		struct measurement
+		{
+			std::string group;
+			std::string name;
+			std::size_t nodes; // tree nodes (or frequency points x nodes) handled per operation
+			std::size_t iterations;
+			double seconds;
+			std::size_t allocations;
+
+			double seconds_per_op() const { return seconds / iterations; }
+			double nodes_per_second() const { return nodes / seconds_per_op(); }
+			double allocations_per_op() const { return static_cast<double>(allocations) / iterations; }
+		};
+
+		std::vector<measurement> results;
+		std::string current_group;
+		double min_seconds{ 0.2 }; // each measurement repeats its body until at least this much time has passed
+
+		std::size_t failed_checks{ 0 }; // any failure makes the run exit with 1
+
+		void check(bool passed, const std::string& what)
+		{
+			std::cout << (passed ? "  check passed: " : "  CHECK FAILED: ") << what << std::endl;
+			if (!passed) { failed_checks++; }
+		}
+
+		void report(const measurement& m)
+		{
+			std::cout << std::left << std::setw(44) << m.name << std::right
+				<< std::setw(12) << std::setprecision(4) << m.seconds_per_op() * 1e3 << " ms/op"
+				<< std::setw(14) << std::setprecision(4) << m.nodes_per_second() << " nodes/s";
+			if (counting_allocations()) { std::cout << std::setw(12) << m.allocations_per_op() << " allocs/op"; }
+			std::cout << std::endl;
+		}
+
+		void measure(const std::string& name, std::size_t nodes, const std::function<void()>& body, std::size_t max_iterations = 1000000,
+			const std::function<void()>& untimed = nullptr)
+		// untimed, if given, runs before each repetition of body and is left out of both the time and the allocations
+		{
+			std::size_t before = allocation_count(), iterations{ 0 }, excluded_allocations{ 0 };
+			auto start = std::chrono::steady_clock::now();
+			double elapsed{ 0 }, excluded{ 0 };
+			while (iterations < max_iterations && (iterations == 0 || elapsed < min_seconds)) {
+				if (untimed) {
+					auto pause = std::chrono::steady_clock::now();
+					std::size_t allocations_before = allocation_count();
+					untimed();
+					excluded += std::chrono::duration<double>(std::chrono::steady_clock::now() - pause).count();
+					excluded_allocations += allocation_count() - allocations_before;
+				}
+				body(); iterations++;
+				elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - excluded;
+			}
+			results.push_back({ current_group, name, nodes, iterations, elapsed, allocation_count() - before - excluded_allocations });
+			report(results.back());
+		}
+
+		void write_json(std::ostream& out)
+		{
+			out << std::setprecision(17) << "{\n  \"benchmarks\": [\n";
+			for (std::size_t i = 0; i < results.size(); i++) {
+				const measurement& m = results[i];
+				out << "    { \"group\": \"" << m.group << "\", \"name\": \"" << m.name << "\", \"iterations\": " << m.iterations
+					<< ", \"seconds_per_op\": " << m.seconds_per_op() << ", \"nodes_per_second\": " << m.nodes_per_second()
+					<< ", \"allocations_per_op\": ";
+				if (counting_allocations()) { out << m.allocations_per_op(); } else { out << "null"; }
+				out << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+			}
+			out << "  ]\n}\n";
+		}
+
+		void write_csv(std::ostream& out)
+		{
+			out << std::setprecision(17) << "group,name,iterations,seconds_per_op,nodes_per_second,allocations_per_op\n";
+			for (const measurement& m : results) {
+				out << m.group << ",\"" << m.name << "\"," << m.iterations << "," << m.seconds_per_op() << ","
+					<< m.nodes_per_second() << ",";
+				if (counting_allocations()) { out << m.allocations_per_op(); } // left empty when not counted
+				out << "\n";
+			}
+		}
+
+		std::size_t count_nodes(const unit& u)
+		{
+			std::size_t n{ 1 };
+			if (u.get_kind() == unit_kind::series || u.get_kind() == unit_kind::parallel) {
+				for (const auto& child : static_cast<const circuit&>(u).get_units()) { n += count_nodes(*child); }
+			}
+			return n;
+		}
+
+		std::unique_ptr<unit> balanced_tree(int depth, int fanout, std::mt19937& generator)
+		// alternating series/parallel levels with random components at the bottom
+		{
+			if (depth == 0) {
+				std::uniform_real_distribution<double> value(1, 10);
+				switch (generator() % 3) {
+				case 0: return std::make_unique<resistor>(value(generator));
+				case 1: return std::make_unique<inductor>(value(generator) / 1000);
+				default: return std::make_unique<capacitor>(value(generator) / 1000000);
+				}
+			}
+			std::vector<std::unique_ptr<unit>> children;
+			for (int i = 0; i < fanout; i++) { children.push_back(balanced_tree(depth - 1, fanout, generator)); }
+			if (depth % 2) { return std::make_unique<series_circuit>(std::move(children)); }
+			return std::make_unique<parallel_circuit>(std::move(children));
+		}
+
+		void collect_components(unit& u, std::vector<unit*>& out)
+		{
+			if (u.get_kind() == unit_kind::series || u.get_kind() == unit_kind::parallel) {
+				for (const auto& child : static_cast<circuit&>(u).get_units()) { collect_components(*child, out); }
+			}
+			else { out.push_back(&u); }
+		}
+
+		void set_component(unit& u, double value)
+		{
+			switch (u.get_kind()) {
+			case unit_kind::resistor: static_cast<resistor&>(u).set_characteristic(value); break;
+			case unit_kind::inductor: static_cast<inductor&>(u).set_characteristic(value / 1000); break;
+			default: static_cast<capacitor&>(u).set_characteristic(value / 1000000); break;
+			}
+		}
+
+		std::unique_ptr<unit> deep_tree(int depth, std::mt19937& generator)
+		// a chain of alternately series and parallel circuits, each holding one component and the next link
+		{
+			std::uniform_real_distribution<double> value(1, 10);
+			std::unique_ptr<unit> tree = std::make_unique<resistor>(value(generator));
+			for (int level = 0; level < depth; level++) {
+				std::vector<std::unique_ptr<unit>> children;
+				children.push_back(std::make_unique<inductor>(value(generator) / 1000));
+				children.push_back(std::move(tree));
+				if (level % 2) { tree = std::make_unique<series_circuit>(std::move(children)); }
+				else { tree = std::make_unique<parallel_circuit>(std::move(children)); }
+			}
+			return tree;
+		}
+
+		std::unique_ptr<unit> wide_tree(int width) // one parallel circuit of many components
+		{
+			std::vector<std::unique_ptr<unit>> children = random_list_generator(width, 10, 50);
+			return std::make_unique<parallel_circuit>(std::move(children));
+		}
+
+		std::vector<double> frequency_grid(std::size_t points) // logarithmic from 1 to 10^6 rad/s
+		{
+			std::vector<double> omegas(points);
+			for (std::size_t k = 0; k < points; k++) { omegas[k] = std::pow(10., 6. * k / (points > 1 ? points - 1 : 1)); }
+			return omegas;
+		}
+
+		void generator_benchmarks()
+		{
+			for (int size : { 1000, 10000, 100000 }) {
+				std::vector<std::unique_ptr<unit>> list;
+				measure("random_list_generator " + std::to_string(size), size, [&] { list = random_list_generator(size, 10, 50, 1); }, 1000000,
+					[&] { list.clear(); }); // time the build, not freeing the previous list
+			}
+			random_circuit_options options;
+			options.size = 1000000;
+			for (std::size_t threads : { 1, 2, 0 }) { // 0 is one per core
+				options.threads = threads;
+				std::unique_ptr<unit> tree;
+				measure("random_circuit 10^6, " + (threads == 0 ? std::string("all") : std::to_string(threads)) + " threads", options.size,
+					[&] { tree = random_circuit(options); }, 20,
+					[&] { tree.reset(); }); // time the build, not freeing the previous tree
+			}
+
+			// the tree depends on the seed and options only, never on how many threads built it
+			auto same = [](const flat_view& a, const flat_view& b) {
+				return a.size == b.size && a.max_stack == b.max_stack && std::equal(a.kinds, a.kinds + a.size, b.kinds)
+					&& std::equal(a.arities, a.arities + a.size, b.arities)
+					&& std::memcmp(a.characteristics, b.characteristics, a.size * sizeof(double)) == 0; // bit for bit
+			};
+			bool identical{ true };
+			thread_pool one(1);
+			for (std::uint64_t seed : { 1, 2, 3 }) {
+				random_circuit_options settings;
+				settings.seed = seed; settings.size = 200000; settings.max_depth = seed == 3 ? 12 : 0;
+				flat_circuit reference(*random_circuit(settings, one));
+				for (std::size_t threads : { 2, 3, 8 }) {
+					thread_pool pool(threads);
+					flat_circuit built(*random_circuit(settings, pool));
+					identical = identical && same(reference.view(), built.view());
+				}
+			}
+			check(identical, "random_circuit builds the same tree on 1, 2, 3 and 8 threads");
+		}
+
+		void shape_benchmarks()
+		{
+			std::mt19937 generator(3);
+			std::complex<double> z;
+			double omega{ 100 };
+			for (bool deep : { true, false }) {
+				std::string shape = deep ? "deep (depth 5000)" : "wide (width 10^5)";
+				std::unique_ptr<unit> tree;
+				auto build = [&] { tree = deep ? deep_tree(5000, generator) : wide_tree(100000); };
+				build();
+				std::size_t nodes = count_nodes(*tree);
+				measure("build " + shape, nodes, build, 1000000, [&] { tree.reset(); }); // time the build, not freeing the previous tree
+				measure("evaluate " + shape, nodes, [&] { z = tree->get_impedance(eval_context{ omega += 1 }); });
+				std::unique_ptr<unit> copy;
+				measure("clone " + shape, nodes, [&] { copy = tree->clone(); }, 1000000, [&] { copy.reset(); });
+			}
+		}
+
+		void allocation_benchmarks()
+		{
+			for (bool pooled : { false, true }) {
+				node_pool::set_pooling(pooled);
+				std::string suffix = pooled ? " (pooled)" : " (heap)";
+				std::mt19937 generator(1);
+				std::unique_ptr<unit> tree;
+				std::size_t nodes = count_nodes(*balanced_tree(6, 6, generator));
+				measure("build 6x6 tree" + suffix, nodes, [&] { tree = balanced_tree(6, 6, generator); }, 1000000, [&] { tree.reset(); });
+				std::unique_ptr<unit> copy;
+				measure("clone 6x6 tree" + suffix, nodes, [&] { copy = tree->clone(); }, 1000000, [&] { copy.reset(); });
+				if (pooled && counting_allocations()) { // nodes and every circuit's list of members come from one arena block
+					check(results.back().allocations_per_op() < 2, "a pooled clone of a 6x6 tree makes one allocation");
+				}
+			}
+			node_pool::set_pooling(true);
+		}
+
+		void copy_benchmarks()
+		{
+			std::mt19937 generator(4);
+			std::vector<std::unique_ptr<unit>> children;
+			for (int i = 0; i < 6; i++) { children.push_back(balanced_tree(5, 6, generator)); }
+			series_circuit source(std::move(children)), target, moved;
+			std::size_t nodes = count_nodes(source);
+			std::optional<series_circuit> copy;
+			measure("copy-construct 6x6 tree", nodes, [&] { copy.emplace(source); }, 1000000, [&] { copy.reset(); }); // not the destructor
+			measure("copy-assign 6x6 tree", nodes, [&] { target = source; });
+			measure("move-assign 6x6 tree (there and back)", nodes, [&] { moved = std::move(target); target = std::move(moved); });
+		}
+
+		void netlist_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 21; settings.size = 1000000;
+			std::unique_ptr<unit> tree = random_circuit(settings);
+			std::ostringstream written;
+			write_netlist(written, *tree);
+			std::string text = written.str();
+			double megabytes = static_cast<double>(text.size()) / 1e6;
+			std::vector<std::unique_ptr<unit>> parsed;
+			measure("parse 10^6-unit netlist", settings.size, [&] { parsed = parse_netlist(text); }, 20, [&] { parsed.clear(); });
+			std::cout << "  " << megabytes / results.back().seconds_per_op() << " MB/s over " << megabytes << " MB" << std::endl;
+			measure("write 10^6-unit netlist", settings.size, [&] { std::ostringstream out; write_netlist(out, *tree); }, 20);
+			std::cout << "  " << megabytes / results.back().seconds_per_op() << " MB/s" << std::endl;
+
+			// writing what was parsed must give back the same text, and the same tree bit for bit
+			std::ostringstream again;
+			if (parsed.size() == 1) { write_netlist(again, *parsed[0]); }
+			eval_context at{ 1234.5 };
+			check(parsed.size() == 1 && again.str() == text && parsed[0]->get_impedance(at) == tree->get_impedance(at),
+				"write, parse, write round-trips a 10^6-unit netlist exactly");
+		}
+
+		void evaluate_benchmarks()
+		{
+			std::mt19937 generator(5);
+			std::unique_ptr<unit> tree = balanced_tree(6, 6, generator);
+			std::size_t nodes = count_nodes(*tree);
+			flat_circuit flat(*tree);
+			double omega{ 100 };
+			std::complex<double> z;
+			measure("get_impedance 6x6 tree (cold cache)", nodes, [&] { z = tree->get_impedance(eval_context{ omega += 1 }); });
+			measure("get_impedance 6x6 tree (cached)", nodes, [&] { z = tree->get_impedance(eval_context{ omega }); });
+			measure("flat_circuit 6x6 tree", nodes, [&] { z = flat.get_impedance(eval_context{ omega += 1 }); });
+			measure("flatten 6x6 tree", nodes, [&] { flat_circuit again(*tree); });
+
+			// the flat form must give exactly the recursive result, not just something close to it
+			std::size_t compared{ 0 }, mismatches{ 0 };
+			for (std::uint64_t seed = 1; seed <= 50; seed++) {
+				random_circuit_options settings;
+				settings.seed = seed; settings.size = 1 + seed * 97 % 2000; settings.min_fanout = 1;
+				settings.max_depth = seed % 3 == 0 ? 4 + seed % 5 : 0; // some deep and narrow, some shallow and wide
+				if (settings.max_depth != 0) { settings.max_fanout = 64; }
+				std::unique_ptr<unit> random_tree = random_circuit(settings);
+				flat_circuit random_flat(*random_tree);
+				std::vector<std::complex<double>> stack(random_flat.view().max_stack);
+				for (double w : { 1e-3, 1., 314.159, 1e4, 2.5e6 }) {
+					std::complex<double> expected = random_tree->get_impedance(eval_context{ w }), actual = random_flat.view().get_impedance(eval_context{ w }, stack.data());
+					compared++;
+					if (!(actual.real() == expected.real() && actual.imag() == expected.imag())) { mismatches++; }
+				}
+			}
+			check(mismatches == 0, "flat_view::get_impedance equals unit::get_impedance exactly on " + std::to_string(compared) + " random tree evaluations");
+		}
+
+		void concurrency_benchmarks()
+		{
+			// one shared tree evaluated from many threads at once, each at its own frequencies, so the impedance caches
+			// in the tree are read and overwritten concurrently; every result must equal the serial one exactly
+			std::mt19937 generator(12);
+			std::unique_ptr<unit> tree = balanced_tree(4, 6, generator);
+			std::size_t nodes = count_nodes(*tree);
+			std::size_t threads = std::max<std::size_t>(8, std::thread::hardware_concurrency());
+			std::vector<double> omegas = frequency_grid(threads * 100);
+			std::vector<std::complex<double>> serial(omegas.size()), concurrent(omegas.size());
+			for (std::size_t k = 0; k < omegas.size(); k++) { serial[k] = tree->get_impedance(eval_context{ omegas[k] }); }
+			std::size_t mismatches{ 0 }, runs{ 0 };
+			measure("4x6 tree, " + std::to_string(threads) + " threads, distinct omegas", nodes * omegas.size(), [&] {
+				std::vector<std::thread> workers;
+				for (std::size_t t = 0; t < threads; t++) {
+					workers.emplace_back([&, t] { // thread t takes every threads-th point, so neighbouring threads interleave
+						for (std::size_t k = t; k < omegas.size(); k += threads) { concurrent[k] = tree->get_impedance(eval_context{ omegas[k] }); }
+					});
+				}
+				for (std::thread& worker : workers) { worker.join(); }
+				for (std::size_t k = 0; k < omegas.size(); k++) { mismatches += concurrent[k] != serial[k]; }
+				runs++;
+			}, 50);
+			check(mismatches == 0, std::to_string(threads) + " threads on a shared tree match serial get_impedance exactly ("
+				+ std::to_string(runs) + " runs, " + std::to_string(mismatches) + " mismatches)");
+		}
+
+		void scaling_benchmarks()
+		{
+			// the 10^6-point parallel sweep of a deep tree at 1, 2, 4, ... threads up to the core count
+			std::mt19937 generator(13);
+			std::unique_ptr<unit> tree = balanced_tree(6, 2, generator);
+			std::size_t nodes = count_nodes(*tree);
+			flat_circuit flat(*tree);
+			std::vector<double> omegas = frequency_grid(1000000);
+			std::vector<std::complex<double>> z;
+			std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+			std::vector<std::size_t> thread_counts;
+			for (std::size_t threads = 1; threads < cores; threads *= 2) { thread_counts.push_back(threads); }
+			thread_counts.push_back(cores);
+			double one_thread{ 0 };
+			for (std::size_t threads : thread_counts) {
+				thread_pool pool(threads);
+				measure("sweep 10^6 points, depth-6 tree, " + std::to_string(threads) + " thread(s)", nodes * omegas.size(),
+					[&] { z = parallel_sweep(flat.view(), omegas, pool); }, 3);
+				double seconds = results.back().seconds_per_op();
+				if (threads == 1) { one_thread = seconds; }
+				else { std::cout << "  speed-up " << one_thread / seconds << " on " << threads << " threads" << std::endl; }
+			}
+			thread_pool pool(std::max<std::size_t>(4, cores)); // at least 4, so pieces are stolen even on a small machine
+			sweep_options options;
+			options.chunk = 1000;
+			z = parallel_sweep(flat.view(), omegas, pool, options);
+			std::size_t mismatches{ 0 };
+			for (std::size_t k = 0; k < omegas.size(); k++) { mismatches += z[k] != tree->get_impedance(eval_context{ omegas[k] }); }
+			check(mismatches == 0, "parallel sweep on " + std::to_string(pool.size()) + " threads equals get_impedance exactly at all 10^6 points");
+		}
+
+		void sweep_benchmarks()
+		{
+			std::mt19937 generator(6);
+			std::unique_ptr<unit> tree = balanced_tree(3, 6, generator);
+			std::size_t nodes = count_nodes(*tree);
+			flat_circuit flat(*tree);
+			std::vector<double> omegas = frequency_grid(100000);
+			std::size_t work = nodes * omegas.size();
+			std::vector<std::complex<double>> z(omegas.size());
+
+			measure("sweep 10^5 points, get_impedance per point", work, [&] {
+				for (std::size_t k = 0; k < omegas.size(); k++) { z[k] = tree->get_impedance(eval_context{ omegas[k] }); }
+			});
+			measure("sweep 10^5 points, flat per point", work, [&] {
+				std::vector<std::complex<double>> stack(flat.view().max_stack);
+				for (std::size_t k = 0; k < omegas.size(); k++) { z[k] = flat.view().get_impedance(eval_context{ omegas[k] }, stack.data()); }
+			});
+			measure("sweep 10^5 points, batched SIMD", work, [&] { z = sweep_impedance(flat.view(), omegas); });
+			thread_pool pool;
+			sweep_options options;
+			measure("sweep 10^5 points, parallel (" + std::to_string(pool.size()) + " threads)", work, [&] { z = parallel_sweep(flat.view(), omegas, pool, options); });
+			options.vectorized = true;
+			measure("sweep 10^5 points, parallel SIMD", work, [&] { z = parallel_sweep(flat.view(), omegas, pool, options); });
+
+			// shorted members and DC make a^2 + b^2 zero or infinite, where the kernels must fall back to what get_impedance does
+			auto group = [](bool series, std::unique_ptr<unit> a, std::unique_ptr<unit> b) -> std::unique_ptr<unit> {
+				std::vector<std::unique_ptr<unit>> members;
+				members.push_back(std::move(a)); members.push_back(std::move(b));
+				if (series) { return std::make_unique<series_circuit>(std::move(members)); }
+				return std::make_unique<parallel_circuit>(std::move(members));
+			};
+			std::vector<std::unique_ptr<unit>> edge_cases;
+			edge_cases.push_back(group(false, std::make_unique<resistor>(0), std::make_unique<inductor>(1e-3)));
+			edge_cases.push_back(group(false, std::make_unique<resistor>(10), std::make_unique<capacitor>(1e-6)));
+			edge_cases.push_back(group(false, std::make_unique<resistor>(0), std::make_unique<resistor>(0)));
+			edge_cases.push_back(group(true, std::make_unique<resistor>(5), group(false, std::make_unique<inductor>(0), std::make_unique<capacitor>(1e-6))));
+			edge_cases.push_back(tree->clone());
+			std::vector<double> edge_omegas{ 0, 1, 0, 1e3, 1e6, 0, 0, 0, 0, 7 }; // DC both in whole packs and next to ordinary lanes
+			bool matches{ true };
+			for (const auto& circuit : edge_cases) {
+				std::vector<std::complex<double>> swept = sweep_impedance(*circuit, edge_omegas);
+				for (std::size_t k = 0; k < edge_omegas.size(); k++) {
+					std::complex<double> exact = circuit->get_impedance(eval_context{ edge_omegas[k] });
+					auto agree = [](double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)) || std::abs(x - y) <= 1e-12 * std::abs(y); };
+					if (!agree(swept[k].real(), exact.real()) || !agree(swept[k].imag(), exact.imag())) { matches = false; } // an open circuit is (inf, nan) in both
+				}
+			}
+			check(matches, "batched kernels agree with get_impedance on shorted members and at DC");
+		}
+
+		void incremental_benchmarks()
+		{
+			std::mt19937 generator(2);
+			std::unique_ptr<unit> tree = balanced_tree(5, 10, generator);
+			std::size_t nodes = count_nodes(*tree);
+			std::vector<unit*> components;
+			collect_components(*tree, components);
+			double omega{ 1000 };
+			std::complex<double> z;
+
+			measure("evaluate 10^5-node tree (cold)", nodes, [&] { z = tree->get_impedance(eval_context{ omega += 1 }); });
+			measure("evaluate 10^5-node tree (cached)", nodes, [&] { z = tree->get_impedance(eval_context{ omega }); });
+			std::uniform_real_distribution<double> value(1, 10);
+			measure("edit one leaf + evaluate", nodes, [&] {
+				set_component(*components[generator() % components.size()], value(generator));
+				z = tree->get_impedance(eval_context{ omega });
+			});
+		}
+
+		void fixed_benchmarks()
+		{
+			namespace f = fixed; // a fifth-order LC ladder with source and load resistors, 12 units
+			const auto ladder = f::series(f::resistor{ 50 }, f::parallel(f::capacitor{ 1e-6 },
+				f::series(f::inductor{ 2e-3 }, f::parallel(f::capacitor{ 2e-6 },
+					f::series(f::inductor{ 2e-3 }, f::parallel(f::capacitor{ 1e-6 }, f::resistor{ 50 })))))); // type is the whole topology
+			std::unique_ptr<unit> tree = ladder.to_unit();
+			flat_circuit flat(*tree);
+			std::vector<double> omegas = frequency_grid(10000);
+			std::size_t work = ladder.size() * omegas.size();
+			std::complex<double> sum;
+
+			measure("ladder 10^4 points, unit tree", work, [&] {
+				for (double omega : omegas) { sum += tree->get_impedance(eval_context{ omega }); }
+			});
+			measure("ladder 10^4 points, flat_circuit", work, [&] {
+				std::vector<std::complex<double>> stack(flat.view().max_stack);
+				for (double omega : omegas) { sum += flat.view().get_impedance(eval_context{ omega }, stack.data()); }
+			});
+			measure("ladder 10^4 points, fixed expression", work, [&] {
+				for (double omega : omegas) { sum += ladder.get_impedance(eval_context{ omega }); }
+			});
+			if (sum == std::complex<double>{}) { std::cout << "unexpected zero" << std::endl; } // keeps the loops from being optimized out
+
+			// against the unit tree it expands to, including shorted members and omega = 0 where a^2 + b^2 is 0 or infinite
+			bool matches{ true };
+			auto compare = [&](const auto& circuit, std::initializer_list<double> at) {
+				std::unique_ptr<unit> expanded = circuit.to_unit();
+				for (double omega : at) {
+					std::complex<double> expected = expanded->get_impedance(eval_context{ omega }), actual = circuit.get_impedance(eval_context{ omega });
+					auto agree = [](double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)) || std::abs(x - y) <= 1e-12 * std::abs(y); };
+					if (!agree(actual.real(), expected.real()) || !agree(actual.imag(), expected.imag())) { matches = false; }
+				}
+			};
+			compare(ladder, { 0, 1, 100, 1e3, 1e4, 1e6 });
+			compare(f::parallel(f::resistor{ 0 }, f::inductor{ 1e-3 }), { 0, 1, 1e3 });
+			compare(f::parallel(f::resistor{ 10 }, f::capacitor{ 1e-6 }), { 0, 1, 1e3 });
+			compare(f::series(f::resistor{ 5 }, f::parallel(f::inductor{ 0 }, f::capacitor{ 1e-6 })), { 0, 1, 1e3 });
+			compare(f::parallel(f::resistor{ 0 }, f::resistor{ 0 }), { 1 });
+			check(matches, "fixed expressions agree with the unit tree, on shorted members and at DC too");
+		}
+
+		void rational_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 1; settings.size = 41; settings.max_fanout = 3; // small enough to compile, degree about 12
+			std::unique_ptr<unit> tree = random_circuit(settings);
+			flat_circuit flat(*tree);
+			std::vector<double> omegas = frequency_grid(100000);
+			std::size_t work = settings.size * omegas.size();
+			std::vector<std::complex<double>> z(omegas.size());
+
+			rational_impedance compiled(*tree, omegas.front(), omegas.back());
+			const rational_report& accuracy = compiled.accuracy();
+			std::cout << "compiled: " << (accuracy.compiled ? "yes" : "no, " + accuracy.reason) << ", degree " << accuracy.degree
+				<< ", max relative error " << accuracy.max_relative_error << " over " << accuracy.points_checked << " points" << std::endl;
+			measure("compile 41-unit tree", settings.size, [&] { rational_impedance again(*tree, omegas.front(), omegas.back()); });
+			measure("sweep 10^5 points, flat per point", work, [&] {
+				std::vector<std::complex<double>> stack(flat.view().max_stack);
+				for (std::size_t k = 0; k < omegas.size(); k++) { z[k] = flat.view().get_impedance(eval_context{ omegas[k] }, stack.data()); }
+			});
+			measure("sweep 10^5 points, batched SIMD", work, [&] { z = sweep_impedance(flat.view(), omegas); });
+			measure("sweep 10^5 points, rational", work, [&] { z = compiled.sweep(omegas); });
+			std::cout << "error over the full sweep: " << compiled.check(omegas).max_relative_error << std::endl;
+
+			// empty groups have no rational form of their own; the compiler must fall back rather than read past its stack
+			std::vector<double> few(omegas.begin(), omegas.begin() + 64);
+			bool fell_back{ true };
+			for (bool parallel : { false, true }) {
+				std::vector<std::unique_ptr<unit>> members;
+				members.push_back(std::make_unique<resistor>(10.));
+				if (parallel) { members.push_back(std::make_unique<parallel_circuit>()); }
+				else { members.push_back(std::make_unique<series_circuit>()); }
+				std::unique_ptr<unit> with_empty = parallel ? std::unique_ptr<unit>(std::make_unique<parallel_circuit>(std::move(members)))
+					: std::unique_ptr<unit>(std::make_unique<series_circuit>(std::move(members)));
+				rational_impedance empty_group(*with_empty, few.front(), few.back());
+				std::cout << "with an empty " << (parallel ? "parallel" : "series") << " group: compiled "
+					<< (empty_group.accuracy().compiled ? "yes" : "no, " + empty_group.accuracy().reason) << std::endl;
+				std::vector<std::complex<double>> swept = empty_group.sweep(few);
+				for (std::size_t k = 0; k < few.size(); k++) {
+					std::complex<double> expected = with_empty->get_impedance(eval_context{ few[k] });
+					fell_back = fell_back && !empty_group.is_rational() && swept[k] == expected;
+				}
+			}
+			check(fell_back, "trees with an empty series or parallel group fall back to the tree evaluator and match it exactly");
+		}
+
+		void reuse_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 9; settings.size = 200;
+			std::unique_ptr<unit> block = random_circuit(settings);
+			std::unique_ptr<unit> tree = block->clone();
+			for (int level = 0; level < 8; level++) { // each level holds two copies of the one below plus a copy of the block
+				std::vector<std::unique_ptr<unit>> children;
+				children.push_back(tree->clone()); children.push_back(block->clone()); children.push_back(std::move(tree));
+				if (level % 2 == 0) { tree = std::make_unique<parallel_circuit>(std::move(children)); }
+				else { tree = std::make_unique<series_circuit>(std::move(children)); }
+			}
+			std::size_t nodes = count_nodes(*tree);
+			circuit_dag dag;
+			std::size_t root = dag.add(*tree);
+			std::cout << nodes << " units in " << tree->footprint() << " bytes as a tree, " << dag.size() << " unique in "
+				<< dag.memory_bytes() << " bytes shared" << std::endl;
+
+			double omega{ 1000 };
+			std::complex<double> z;
+			flat_circuit flat(*tree);
+			measure("share 10^5-unit tree", nodes, [&] { circuit_dag again; again.add(*tree); });
+			measure("evaluate 10^5-unit tree (cold)", nodes, [&] { z = tree->get_impedance(eval_context{ omega += 1 }); });
+			measure("evaluate flat_circuit", nodes, [&] { z = flat.get_impedance(eval_context{ omega += 1 }); });
+			measure("evaluate circuit_dag", nodes, [&] { z = dag.get_impedance(root, eval_context{ omega += 1 }); });
+
+			// a second, unrelated tree in the same dag: asking for one root must not evaluate the other
+			settings.seed = 10; settings.size = 2000;
+			std::unique_ptr<unit> other = random_circuit(settings);
+			std::size_t other_root = dag.add(*other);
+			measure("evaluate circuit_dag, second tree", count_nodes(*other), [&] { z = dag.get_impedance(other_root, eval_context{ omega += 1 }); });
+			eval_context at{ 1234.5 };
+			std::vector<std::complex<double>> both = dag.get_impedances({ other_root, root }, at);
+			bool no_node_rejected{ false };
+			try { dag.get_impedance(circuit_dag::no_node, at); }
+			catch (const std::out_of_range&) { no_node_rejected = true; }
+			bool to_unit_rejected{ false }, evaluate_rejected{ false };
+			try { dag.to_unit(dag.size()); }
+			catch (const std::out_of_range&) { to_unit_rejected = true; }
+			std::vector<std::complex<double>> values(dag.size() + 1);
+			try { dag.evaluate(at, dag.size(), values.data()); }
+			catch (const std::out_of_range&) { evaluate_rejected = true; }
+			check(dag.get_impedance(other_root, at) == other->get_impedance(at) && both[0] == other->get_impedance(at)
+				&& both[1] == tree->get_impedance(at) && no_node_rejected && to_unit_rejected && evaluate_rejected,
+				"circuit_dag roots equal get_impedance exactly, and ids past the end are rejected");
+		}
+
+		network grid_network(int side, std::mt19937& generator) // a side x side mesh; not series-parallel, so only the solver handles it
+		{
+			std::uniform_real_distribution<double> value(1, 10);
+			network mesh;
+			std::vector<std::uint32_t> nodes(static_cast<std::size_t>(side) * side);
+			for (std::size_t k = 0; k < nodes.size(); k++) { nodes[k] = mesh.add_node(); }
+			for (int i = 0; i < side; i++) {
+				for (int j = 0; j < side; j++) {
+					std::uint32_t here = nodes[i * side + j];
+					if (i + 1 < side) {
+						switch ((i + j) % 3) { // vertical edges cycle through R, L and C
+						case 0: mesh.add(unit_kind::resistor, here, nodes[(i + 1) * side + j], value(generator)); break;
+						case 1: mesh.add(unit_kind::inductor, here, nodes[(i + 1) * side + j], value(generator) / 1000); break;
+						default: mesh.add(unit_kind::capacitor, here, nodes[(i + 1) * side + j], value(generator) / 1000); break;
+						}
+					}
+					if (j + 1 < side) { mesh.add(unit_kind::resistor, here, nodes[i * side + j + 1], value(generator)); }
+				}
+			}
+			mesh.set_port(nodes.front(), nodes.back());
+			return mesh;
+		}
+
+		void mna_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 3; settings.size = 1000;
+			std::unique_ptr<unit> tree = random_circuit(settings);
+			std::vector<double> omegas = frequency_grid(100);
+			double difference = cross_check(*tree, omegas);
+			std::cout << "cross-check against get_impedance, 1000-unit tree: max relative difference " << difference << std::endl;
+			check(difference <= 1e-9, "the MNA solver agrees with get_impedance on a 1000-unit tree to within 1e-9"); // NaN fails too
+			network tree_network = to_network(*tree);
+			mna_solver tree_solver(tree_network);
+			double omega{ 1000 };
+			std::complex<double> z;
+			measure("analyse 1000-unit tree", settings.size, [&] { mna_solver again(tree_network); });
+			measure("solve 1000-unit tree, one frequency", settings.size, [&] { z = tree_solver.get_impedance(eval_context{ omega += 1 }); });
+
+			std::mt19937 generator(7);
+			for (int side : { 100, 317 }) {
+				network mesh = grid_network(side, generator);
+				std::size_t nodes = mesh.node_count();
+				std::string label = std::to_string(side) + "x" + std::to_string(side) + " mesh";
+				std::unique_ptr<mna_solver> solver;
+				measure("analyse " + label, nodes, [&] { solver = std::make_unique<mna_solver>(mesh); }, side > 100 ? 1 : 1000000);
+				std::cout << "  " << solver->size() << " equations, " << solver->factor_nonzeros() << " nonzeros in L" << std::endl;
+				measure("solve " + label + ", one frequency", nodes, [&] { z = solver->get_impedance(eval_context{ omega += 1 }); }, side > 100 ? 2 : 1000000);
+			}
+		}
+
+		void monte_carlo_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 5; settings.size = 40;
+			std::unique_ptr<unit> tree = random_circuit(settings);
+			flat_circuit flat(*tree);
+			monte_carlo_options options;
+			options.seed = 11; options.trials = 1000000; options.omega = 1000;
+			thread_pool all_cores;
+			monte_carlo_result result;
+			std::vector<std::size_t> thread_counts{ 1 };
+			if (all_cores.size() > 1) { thread_counts.push_back(all_cores.size()); }
+			std::vector<monte_carlo_result> by_thread_count;
+			for (std::size_t threads : thread_counts) {
+				thread_pool pool(threads);
+				measure("10^6 trials, 40-unit tree, " + std::to_string(threads) + " thread(s)", flat.size() * options.trials,
+					[&] { result = monte_carlo(flat.view(), options, pool); }, 3);
+				by_thread_count.push_back(result);
+			}
+			if (all_cores.size() != 3) { // three workers, so chunks finish out of order even on a small machine
+				thread_pool three(3);
+				by_thread_count.push_back(monte_carlo(flat.view(), options, three));
+				thread_counts.push_back(3);
+			}
+			bool identical{ true };
+			for (const monte_carlo_result& other : by_thread_count) {
+				const monte_carlo_result& first = by_thread_count.front();
+				for (auto moments : { std::make_pair(&first.magnitude, &other.magnitude), std::make_pair(&first.phase, &other.phase) }) {
+					const running_moments& a = *moments.first;
+					const running_moments& b = *moments.second;
+					identical = identical && a.count() == b.count() && a.mean() == b.mean() && a.variance() == b.variance()
+						&& a.minimum() == b.minimum() && a.maximum() == b.maximum();
+				}
+				for (double q : { 0.01, 0.05, 0.5, 0.95, 0.99 }) {
+					identical = identical && first.magnitude_distribution.quantile(q) == other.magnitude_distribution.quantile(q)
+						&& first.phase_distribution.quantile(q) == other.phase_distribution.quantile(q);
+				}
+			}
+			std::string counts;
+			for (std::size_t threads : thread_counts) { counts += (counts.empty() ? "" : ", ") + std::to_string(threads); }
+			check(identical, "Monte Carlo moments and percentiles are bit-identical on " + counts + " threads");
+			std::complex<double> nominal = tree->get_impedance(eval_context{ options.omega });
+			std::cout << "  nominal |Z| " << std::abs(nominal) << ", mean " << result.magnitude.mean() << ", std dev " << std::sqrt(result.magnitude.variance())
+				<< ", 5%/50%/95% " << result.magnitude_distribution.quantile(0.05) << " / " << result.magnitude_distribution.quantile(0.5)
+				<< " / " << result.magnitude_distribution.quantile(0.95) << std::endl;
+			std::cout << "  phase mean " << result.phase.mean() << " rad, 5%/95% " << result.phase_distribution.quantile(0.05)
+				<< " / " << result.phase_distribution.quantile(0.95) << std::endl;
+
+			parallel_circuit shorted; // R(0) || L, and R || C with tolerances wide enough to draw values at or below zero
+			shorted.add_unit(std::make_unique<resistor>(0.)); shorted.add_unit(std::make_unique<inductor>(1e-3));
+			parallel_circuit wide;
+			wide.add_unit(std::make_unique<resistor>(10.)); wide.add_unit(std::make_unique<capacitor>(1e-6));
+			monte_carlo_options edge = options;
+			edge.trials = 20000; edge.tolerances.resistor = 3; edge.tolerances.capacitor = 2; edge.threads = 1;
+			bool finite{ true };
+			for (const unit* circuit : { static_cast<const unit*>(&shorted), static_cast<const unit*>(&wide) }) {
+				for (tolerance_distribution distribution : { tolerance_distribution::uniform, tolerance_distribution::normal }) {
+					edge.tolerances.distribution = distribution;
+					monte_carlo_result r = monte_carlo(*circuit, edge);
+					finite = finite && std::isfinite(r.magnitude.mean()) && std::isfinite(r.phase.mean()) && r.magnitude.minimum() >= 0
+						&& r.magnitude_distribution.count() == edge.trials && r.phase_distribution.count() == edge.trials;
+				}
+			}
+			check(finite, "Monte Carlo on a shorted member and on tolerances of 200-300% gives finite statistics");
+		}
+
+		void sensitivity_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 13; settings.size = 10000;
+			std::unique_ptr<unit> tree = random_circuit(settings);
+			flat_circuit flat(*tree);
+			flat_view view = flat.view();
+			eval_context context{ 1000 };
+			double difference = check_sensitivities(*tree, context);
+			std::cout << "reverse mode against finite differences, 10^4-unit tree: max difference " << difference << std::endl;
+			check(difference <= 1e-6, "reverse-mode derivatives agree with central differences to within 1e-6");
+			impedance_gradient gradient;
+			measure("all derivatives, reverse mode, 10^4 units", flat.size(), [&] { gradient = impedance_sensitivities(view, context); }, 1000);
+			std::vector<double> values(view.characteristics, view.characteristics + view.size);
+			flat_view perturbed = view;
+			perturbed.characteristics = values.data();
+			std::vector<std::complex<double>> stack(view.max_stack);
+			std::complex<double> z;
+			measure("all derivatives, forward differences, 10^4 units", flat.size() * gradient.components.size(), [&] {
+				for (std::uint32_t i : gradient.components) { values[i] *= 1 + 1e-7; z = perturbed.get_impedance(context, stack.data()); values[i] = view.characteristics[i]; }
+			}, 1);
+
+			settings.seed = 9; settings.size = 30;
+			std::unique_ptr<unit> target = random_circuit(settings);
+			std::vector<double> omegas = frequency_grid(40);
+			std::vector<std::complex<double>> curve;
+			for (double omega : omegas) { curve.push_back(target->get_impedance(eval_context{ omega })); }
+			std::mt19937 generator(3);
+			std::uniform_real_distribution<double> detune(0.95, 1.05);
+			fit_result fitted;
+			std::unique_ptr<unit> start;
+			auto detuned_start = [&] { // a copy of the target with every value off by up to 5%
+				start = target->clone();
+				for (unit* component : component_list(*start)) {
+					double value = flat_characteristic(*component) * detune(generator);
+					switch (component->get_kind()) {
+					case unit_kind::resistor: static_cast<resistor*>(component)->set_characteristic(value); break;
+					case unit_kind::inductor: static_cast<inductor*>(component)->set_characteristic(value); break;
+					default: static_cast<capacitor*>(component)->set_characteristic(value); break;
+					}
+				}
+			};
+			detuned_start();
+			fitted = fit_components(*start, omegas, curve); // untimed, to count the passes over the curve one fit makes
+			measure("fit 30-unit tree to a 40-point curve", settings.size * omegas.size() * fitted.evaluations,
+				[&] { fitted = fit_components(*start, omegas, curve); }, 100, detuned_start);
+			std::cout << "  error " << fitted.initial_error << " -> " << fitted.final_error << " in " << fitted.iterations << " iterations" << std::endl;
+			check(fitted.final_error < fitted.initial_error, "fitting a detuned copy reduces the error against the target curve");
+		}
+
+		void adaptive_benchmarks()
+		{
+			random_circuit_options settings;
+			settings.seed = 2; settings.size = 200;
+			std::unique_ptr<unit> tree = random_circuit(settings);
+			flat_circuit flat(*tree);
+			std::vector<double> omegas = frequency_grid(100000);
+			std::vector<std::complex<double>> dense;
+			adaptive_sweep_options options;
+			adaptive_sweep_result adaptive;
+			measure("dense sweep, 10^5 points, 200-unit tree", flat.size() * omegas.size(), [&] { dense = sweep_impedance(flat.view(), omegas); }, 100);
+			adaptive = adaptive_sweep(flat.view(), options);
+			measure("adaptive sweep, 200-unit tree", flat.size() * adaptive.evaluations, [&] { adaptive = adaptive_sweep(flat.view(), options); }, 1000);
+			double magnitude_error{ 0 }, phase_error{ 0 };
+			for (std::size_t k = 0; k < omegas.size(); k++) {
+				std::complex<double> z = adaptive.interpolate(omegas[k]);
+				magnitude_error = std::max(magnitude_error, std::abs(std::abs(z) / std::abs(dense[k]) - 1));
+				phase_error = std::max(phase_error, std::abs(std::arg(z / dense[k]))); // wrapped, so +pi against -pi is no error
+			}
+			std::cout << "  " << adaptive.evaluations << " evaluations, " << adaptive.resonances.size() << " resonances; against the dense sweep, |Z| within "
+				<< magnitude_error << " and phase within " << phase_error << " rad" << std::endl;
+			check(adaptive.complete && magnitude_error <= options.magnitude_tolerance && phase_error <= options.phase_tolerance,
+				"adaptive sweep interpolates the dense sweep within its magnitude and phase tolerances");
+		}
+
+		void transient_benchmarks()
+		{
+			auto two_terminal = [](bool series, std::unique_ptr<unit> a, std::unique_ptr<unit> b, std::unique_ptr<unit> c = nullptr) -> std::unique_ptr<unit> {
+				std::vector<std::unique_ptr<unit>> members;
+				members.push_back(std::move(a)); members.push_back(std::move(b));
+				if (c) { members.push_back(std::move(c)); }
+				if (series) { return std::make_unique<series_circuit>(std::move(members)); }
+				return std::make_unique<parallel_circuit>(std::move(members));
+			};
+			auto largest_error = [](const unit& u, const transient_options& options, const std::function<double(double)>& exact, double scale) {
+				// against the analytic response, as a fraction of scale; t = 0 is skipped, where the exact answer jumps
+				double error{ 0 };
+				simulate_transient(u, options, [&](const transient_sample* samples, std::size_t count) {
+					for (std::size_t k = 0; k < count; k++) {
+						if (samples[k].time == 0) { continue; }
+						double response = options.drive == drive_kind::voltage ? samples[k].current : samples[k].voltage;
+						error = std::max(error, std::abs(response - exact(samples[k].time)) / scale);
+					}
+				});
+				return error;
+			};
+			transient_options options;
+			options.source = waveform::step(1);
+			options.stop_time = 5e-3; options.step = 1e-6;
+			double alpha{ 500 }, omega_0{ 1e4 }, omega_d = std::sqrt(omega_0 * omega_0 - alpha * alpha);
+			std::unique_ptr<unit> rc = two_terminal(true, std::make_unique<resistor>(1000), std::make_unique<capacitor>(1e-6)); // tau 1 ms
+			std::unique_ptr<unit> rl = two_terminal(true, std::make_unique<resistor>(10), std::make_unique<inductor>(1e-2)); // tau 1 ms
+			std::unique_ptr<unit> series_rlc = two_terminal(true, std::make_unique<resistor>(10), std::make_unique<inductor>(1e-2), std::make_unique<capacitor>(1e-6));
+			std::unique_ptr<unit> parallel_rlc = two_terminal(false, std::make_unique<resistor>(1000), std::make_unique<inductor>(1e-2), std::make_unique<capacitor>(1e-6));
+			transient_options current_step = options;
+			current_step.drive = drive_kind::current;
+			current_step.source = waveform::step(1e-3);
+			for (bool adaptive : { false, true }) {
+				options.adaptive = current_step.adaptive = adaptive;
+				double errors[4]{
+					largest_error(*rc, options, [](double t) { return 1e-3 * std::exp(-t / 1e-3); }, 1e-3),
+					largest_error(*rl, options, [](double t) { return 0.1 * (1 - std::exp(-t / 1e-3)); }, 0.1),
+					largest_error(*series_rlc, options, [&](double t) { return std::exp(-alpha * t) * std::sin(omega_d * t) / (omega_d * 1e-2); }, 1 / (omega_d * 1e-2)),
+					largest_error(*parallel_rlc, current_step, [&](double t) { return 1e-3 * std::exp(-alpha * t) * std::sin(omega_d * t) / (omega_d * 1e-6); }, 1e-3 / (omega_d * 1e-6)) };
+				std::string method = adaptive ? "adaptive steps" : "fixed 1 us steps";
+				std::cout << "against analytic step responses, " << method << ": RC " << errors[0] << ", RL " << errors[1]
+					<< ", series RLC " << errors[2] << ", parallel RLC " << errors[3] << std::endl;
+				// limits a few times above what the solver achieves, so a regression in accuracy fails the run
+				check(errors[0] < (adaptive ? 1e-7 : 1e-6) && errors[1] < (adaptive ? 1e-7 : 1e-6),
+					std::string("RC and RL step responses within ") + (adaptive ? "1e-7" : "1e-6") + ", " + method);
+				check(errors[2] < 1e-4 && errors[3] < 1e-4, "series and parallel RLC step responses within 1e-4, " + method);
+			}
+
+			// a repeating trapezoidal pulse into the RL circuit: the current is a sum of ramp responses
+			// (t - tau (1 - e^(-t / tau))) / R, one starting at each corner, and adaptive steps must land on every corner
+			transient_options pulsed = options;
+			pulsed.source = waveform::pulse(1, 0.5e-3, 0.2e-3, 1e-3, 0.3e-3, 2e-3);
+			const waveform& pulse = pulsed.source;
+			auto ramp = [](double t) { return t > 0 ? (t - 1e-3 * (1 - std::exp(-t / 1e-3))) / 10 : 0.; };
+			auto pulse_current = [&](double t) {
+				double i{ 0 };
+				for (double start = pulse.delay; start < t; start += pulse.period) {
+					i += (ramp(t - start) - ramp(t - start - pulse.rise)) / pulse.rise
+						- (ramp(t - start - pulse.rise - pulse.width) - ramp(t - start - pulse.rise - pulse.width - pulse.fall)) / pulse.fall;
+				}
+				return i;
+			};
+			for (bool adaptive : { false, true }) {
+				pulsed.adaptive = adaptive;
+				double error = largest_error(*rl, pulsed, pulse_current, 0.1);
+				std::vector<double> times;
+				for (const transient_sample& sample : transient_response(*rl, pulsed)) { times.push_back(sample.time); }
+				bool on_corners{ true };
+				for (double corner = pulse.next_breakpoint(0); corner <= pulsed.stop_time; corner = pulse.next_breakpoint(corner)) {
+					on_corners = on_corners && std::find(times.begin(), times.end(), corner) != times.end();
+				}
+				std::string method = adaptive ? "adaptive steps" : "fixed 1 us steps";
+				std::cout << "against the analytic pulse response, " << method << ": RL " << error << std::endl;
+				// adaptive error follows relative_tolerance, which allows more here than the fixed 1 us steps give
+				check(error < (adaptive ? 2e-6 : 5e-7) && (!adaptive || on_corners), std::string("RL pulse response within ")
+					+ (adaptive ? "2e-6, with a sample on every corner" : "5e-7") + ", " + method);
+			}
+
+			series_circuit empty_group; // an empty parallel circuit in series with a resistor
+			empty_group.add_unit(std::make_unique<resistor>(1.)); empty_group.add_unit(std::make_unique<parallel_circuit>());
+			bool rejected{ false };
+			try { simulate_transient(empty_group, options, [](const transient_sample*, std::size_t) {}); }
+			catch (const std::invalid_argument&) { rejected = true; }
+			check(rejected, "a circuit with an empty parallel group is rejected");
+
+			double last{ 0 };
+			transient_sink keep_last = [&](const transient_sample* samples, std::size_t count) { last += samples[count - 1].current; };
+			transient_result result;
+			options.adaptive = false;
+			options.stop_time = 1; // 10^6 steps
+			flat_circuit rlc_flat(*series_rlc);
+			measure("transient, series RLC, 10^6 fixed steps", rlc_flat.size() * 1000000, [&] { result = simulate_transient(rlc_flat.view(), options, keep_last); }, 100);
+			std::cout << "  " << static_cast<double>(result.steps) / results.back().seconds_per_op() << " steps/s" << std::endl;
+
+			random_circuit_options settings;
+			settings.seed = 4; settings.size = 1000;
+			flat_circuit tree(*random_circuit(settings));
+			options.stop_time = 1e-1; // 10^5 steps
+			measure("transient, 1000-unit tree, 10^5 fixed steps", tree.size() * 100000, [&] { result = simulate_transient(tree.view(), options, keep_last); }, 100);
+			std::cout << "  " << static_cast<double>(result.steps) / results.back().seconds_per_op() << " steps/s" << std::endl;
+
+			options.adaptive = true;
+			options.stop_time = 5e-3;
+			result = simulate_transient(rlc_flat.view(), options, keep_last); // the step count, for the work per run
+			measure("transient, series RLC, adaptive over 5 ms", rlc_flat.size() * result.steps, [&] { result = simulate_transient(rlc_flat.view(), options, keep_last); }, 1000);
+			std::cout << "  " << result.steps << " steps, " << result.rejected << " rejected, from " << result.smallest_step << " to " << result.largest_step << " s" << std::endl;
+		}
+
+		const std::vector<std::pair<std::string, std::function<void()>>>& registry()
+		{
+			static const std::vector<std::pair<std::string, std::function<void()>>> benchmarks{
+				{ "generator", generator_benchmarks },
+				{ "shape", shape_benchmarks },
+				{ "allocation", allocation_benchmarks },
+				{ "copy", copy_benchmarks },
+				{ "netlist", netlist_benchmarks },
+				{ "evaluate", evaluate_benchmarks },
+				{ "concurrency", concurrency_benchmarks },
+				{ "sweep", sweep_benchmarks },
+				{ "scaling", scaling_benchmarks },
+				{ "incremental", incremental_benchmarks },
+				{ "fixed", fixed_benchmarks },
+				{ "rational", rational_benchmarks },
+				{ "reuse", reuse_benchmarks },
+				{ "mna", mna_benchmarks },
+				{ "montecarlo", monte_carlo_benchmarks },
+				{ "sensitivity", sensitivity_benchmarks },
+				{ "adaptive", adaptive_benchmarks },
+				{ "transient", transient_benchmarks },
+			};
+			return benchmarks;
+		}
+	}
+
+	int run(const std::vector<std::string>& arguments)
+	{
+		std::vector<std::string> names;
+		std::string json_path, csv_path, trace_path;
+		bool stats{ false };
+		for (std::size_t i = 0; i < arguments.size(); i++) {
+			if (arguments[i] == "--json" && i + 1 < arguments.size()) { json_path = arguments[++i]; }
+			else if (arguments[i] == "--csv" && i + 1 < arguments.size()) { csv_path = arguments[++i]; }
+			else if (arguments[i] == "--min-time" && i + 1 < arguments.size()) { min_seconds = std::atof(arguments[++i].c_str()); }
+			else if (arguments[i] == "--trace" && i + 1 < arguments.size()) { trace_path = arguments[++i]; }
+			else if (arguments[i] == "--stats") { stats = true; }
+			else { names.push_back(arguments[i]); }
+		}
+
+		unit_namespace::instrument::set_tracing(!trace_path.empty());
+		int found{ 0 };
+		for (const auto& entry : registry()) {
+			bool wanted = names.empty();
+			for (const auto& name : names) { if (name == entry.first) { wanted = true; } }
+			if (!wanted) { continue; }
+			current_group = entry.first;
+			std::cout << "[" << entry.first << "]" << std::endl;
+			entry.second();
+			found++;
+		}
+		if (found == 0) {
+			std::cout << "No benchmark with that name. Available:";
+			for (const auto& entry : registry()) { std::cout << " " << entry.first; }
+			std::cout << std::endl;
+			return 1;
+		}
+
+		if (!json_path.empty()) {
+			std::ofstream out(json_path);
+			if (!out) { std::cout << "Cannot write " << json_path << std::endl; return 1; }
+			write_json(out);
+		}
+		if (!csv_path.empty()) {
+			std::ofstream out(csv_path);
+			if (!out) { std::cout << "Cannot write " << csv_path << std::endl; return 1; }
+			write_csv(out);
+		}
+		if (!trace_path.empty()) {
+			std::ofstream out(trace_path);
+			if (!out) { std::cout << "Cannot write " << trace_path << std::endl; return 1; }
+			unit_namespace::instrument::write_trace(out);
+		}
+		if (stats) { unit_namespace::instrument::write_stats(std::cout); }
+		if (failed_checks > 0) { std::cout << failed_checks << " check(s) failed" << std::endl; return 1; }
+		return 0;
+	}
+}
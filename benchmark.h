@@ -0,0 +1,26 @@
+// header file for the built-in benchmark suite. It is run from the command line with
+//   --benchmark [group ...] [--json file] [--csv file] [--min-time seconds] [--stats] [--trace file]
+// With no groups every benchmark runs. Each result reports time per operation and throughput in nodes per second;
+// --json and --csv also write the results in machine-readable form for regression tracking. Heap allocations per
+// operation are reported only in a build with UNIT_COUNT_ALLOCATIONS defined, which replaces the global operator new
+// with a counting one; other builds keep the default allocator (allocations_per_op is null in JSON, empty in CSV).
+// Some groups also check their results; if any check fails the run exits with 1.
+// In a build with UNIT_INSTRUMENT defined, --stats prints the instrumentation counters afterwards and --trace writes the
+// timeline of instrumented operations as a Chrome trace (see instrument.h).
+#pragma once
+#ifndef benchmark_h
+#define benchmark_h
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace bench {
+
+	bool counting_allocations(); // whether this build defines UNIT_COUNT_ALLOCATIONS
+	std::size_t allocation_count(); // calls to the global operator new since the program started; 0 if not counting
+
+	int run(const std::vector<std::string>& arguments); // returns the process exit code
+}
+
+#endif
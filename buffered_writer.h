@@ -0,0 +1,49 @@
+// header file for a block-buffered text writer. Output is gathered in a large buffer and handed to the stream in big
+// writes, never flushed per line, and numbers are formatted with std::to_chars straight into the buffer: no locale,
+// no stream state, and doubles in shortest round-trip form. Used wherever a lot of text is written at once.
+#pragma once
+#ifndef buffered_writer_h
+#define buffered_writer_h
+
+#include <ostream>
+#include <vector>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+namespace unit_namespace {
+
+	class buffered_writer
+	{
+	private:
+		std::ostream& out;
+		std::vector<char> buffer;
+		std::size_t used{ 0 };
+
+		void make_room(std::size_t bytes) { if (used + bytes > buffer.size()) { flush(); } }
+	public:
+		explicit buffered_writer(std::ostream& stream, std::size_t capacity = 1 << 20) : out{ stream }, buffer(capacity < 64 ? 64 : capacity) {}
+		~buffered_writer() { flush(); }
+		buffered_writer(const buffered_writer&) = delete;
+		buffered_writer& operator=(const buffered_writer&) = delete;
+
+		void flush() { out.write(buffer.data(), static_cast<std::streamsize>(used)); used = 0; } // hands the buffer to the stream; does not flush the stream
+		void put(std::string_view text)
+		{
+			if (text.size() > buffer.size()) { flush(); out.write(text.data(), static_cast<std::streamsize>(text.size())); return; }
+			make_room(text.size());
+			std::memcpy(buffer.data() + used, text.data(), text.size());
+			used += text.size();
+		}
+		void put(const char* text) { put(std::string_view(text)); }
+		void put(char c) { make_room(1); buffer[used++] = c; }
+		void put(std::size_t n) { make_room(24); used = static_cast<std::size_t>(std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), n).ptr - buffer.data()); }
+		void put(std::int64_t n) { make_room(24); used = static_cast<std::size_t>(std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), n).ptr - buffer.data()); }
+		void put(double x) { make_room(32); used = static_cast<std::size_t>(std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), x).ptr - buffer.data()); }
+		// inf and nan come out as "inf", "-inf" and "nan"
+	};
+}
+
+#endif
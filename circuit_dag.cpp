@@ -0,0 +1,194 @@
+#include "circuit_dag.h"
+
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace unit_namespace {
+
+	namespace {
+		std::uint64_t mix(std::uint64_t h, std::uint64_t value) // splitmix64 finaliser applied to a running hash
+		{
+			h ^= value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+			h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 27; h *= 0x94D049BB133111EBull;
+			return h ^ (h >> 31);
+		}
+
+		std::uint64_t bits_of(double value)
+		{
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+	}
+
+	circuit_dag::circuit_dag() : first_child{ 0 }, table(64, no_node) {}
+
+	void circuit_dag::grow_table()
+	{
+		std::vector<std::uint32_t> bigger(table.size() * 2, no_node);
+		std::size_t mask = bigger.size() - 1;
+		for (std::uint32_t id = 0; id < kinds.size(); id++) {
+			std::size_t slot = hashes[id] & mask;
+			while (bigger[slot] != no_node) { slot = (slot + 1) & mask; }
+			bigger[slot] = id;
+		}
+		table.swap(bigger);
+	}
+
+	std::uint32_t circuit_dag::intern(std::uint8_t kind, double characteristic, const std::uint32_t* children, std::size_t count)
+	{
+		std::uint64_t h = mix(mix(kind, bits_of(characteristic)), count); // characteristics compare by bits, so -0 and 0 differ
+		for (std::size_t j = 0; j < count; j++) { h = mix(h, children[j]); }
+
+		std::size_t mask = table.size() - 1, slot = h & mask;
+		for (; table[slot] != no_node; slot = (slot + 1) & mask) {
+			std::uint32_t id = table[slot];
+			if (hashes[id] == h && kinds[id] == kind && bits_of(characteristics[id]) == bits_of(characteristic)
+				&& get_arity(id) == count && std::equal(children, children + count, child_ids.begin() + first_child[id])) {
+				return id; // seen before: share it
+			}
+		}
+
+		if (kinds.size() >= no_node) { throw std::length_error("circuit_dag: too many unique nodes"); }
+		std::uint32_t id = static_cast<std::uint32_t>(kinds.size());
+		kinds.push_back(kind);
+		characteristics.push_back(characteristic);
+		child_ids.insert(child_ids.end(), children, children + count);
+		first_child.push_back(static_cast<std::uint32_t>(child_ids.size()));
+		hashes.push_back(h);
+		table[slot] = id;
+		if (kinds.size() * 2 > table.size()) { grow_table(); } // keep the load factor at most one half
+		return id;
+	}
+
+	std::size_t circuit_dag::add(const flat_view& circuit)
+	{
+		std::vector<std::uint32_t> stack; // ids of finished subtrees, as in the flat evaluator
+		stack.reserve(circuit.max_stack);
+		for (std::size_t i = 0; i < circuit.size; i++) {
+			std::size_t arity = circuit.arities[i];
+			std::uint32_t id = intern(circuit.kinds[i], circuit.characteristics[i], stack.data() + stack.size() - arity, arity);
+			stack.resize(stack.size() - arity);
+			stack.push_back(id);
+		}
+		added += circuit.size;
+		return stack.empty() ? no_node : stack.back();
+	}
+
+	std::size_t circuit_dag::add(const unit& root)
+	{
+		flat_circuit flat(root);
+		return add(flat.view());
+	}
+
+	std::size_t circuit_dag::memory_bytes() const
+	{
+		return kinds.capacity() * sizeof(std::uint8_t) + characteristics.capacity() * sizeof(double)
+			+ (first_child.capacity() + child_ids.capacity() + table.capacity()) * sizeof(std::uint32_t)
+			+ hashes.capacity() * sizeof(std::uint64_t);
+	}
+
+	void circuit_dag::evaluate_node(std::size_t i, const eval_context& context, std::complex<double>* values) const
+	{
+		// same operations in the same order as flat_view::get_impedance, so results round identically
+		double c = characteristics[i];
+		const std::uint32_t* child = child_ids.data() + first_child[i];
+		const std::uint32_t* end = child_ids.data() + first_child[i + 1];
+		switch (static_cast<unit_kind>(kinds[i])) {
+		case unit_kind::resistor: values[i] = std::complex<double>{ c, 0 }; break;
+		case unit_kind::inductor: values[i] = std::complex<double>{ 0, c * context.omega }; break;
+		case unit_kind::capacitor: values[i] = std::complex<double>{ 0, -1. / (c * context.omega) }; break;
+		case unit_kind::series: {
+			std::complex<double> sum;
+			for (; child != end; child++)
+				sum += values[*child];
+			values[i] = sum;
+			break;
+		}
+		case unit_kind::parallel: {
+			std::complex<double> sum;
+			for (; child != end; child++)
+				sum += 1. / values[*child];
+			values[i] = 1. / sum;
+			break;
+		}
+		}
+	}
+
+	std::size_t circuit_dag::mark_reachable(const std::vector<std::size_t>& ids, std::vector<char>& needed) const
+	{
+		std::size_t last{ 0 };
+		for (std::size_t id : ids) {
+			if (id >= size()) { throw std::out_of_range("circuit_dag: no node with id " + std::to_string(id)); }
+			last = std::max(last, id);
+		}
+		needed.assign(last + 1, 0);
+		for (std::size_t id : ids) { needed[id] = 1; }
+		for (std::size_t i = last + 1; i-- > 0;) { // children come before their parents, so one backward pass finds them all
+			if (!needed[i]) { continue; }
+			for (std::uint32_t j = first_child[i]; j < first_child[i + 1]; j++) { needed[child_ids[j]] = 1; }
+		}
+		return last;
+	}
+
+	void circuit_dag::evaluate(const eval_context& context, std::size_t last, std::complex<double>* values) const
+	{
+		if (last >= size()) { throw std::out_of_range("circuit_dag: no node with id " + std::to_string(last)); }
+		for (std::size_t i = 0; i <= last; i++) { evaluate_node(i, context, values); }
+	}
+
+	std::complex<double> circuit_dag::get_impedance(std::size_t id, const eval_context& context) const
+	{
+		std::vector<std::complex<double>> result = get_impedances({ id }, context);
+		return result[0];
+	}
+
+	std::vector<std::complex<double>> circuit_dag::get_impedances(const std::vector<std::size_t>& ids, const eval_context& context) const
+	{
+		std::vector<std::complex<double>> result(ids.size());
+		if (ids.empty()) { return result; }
+		std::vector<char> needed;
+		std::size_t last = mark_reachable(ids, needed);
+		std::vector<std::complex<double>> values(last + 1);
+		for (std::size_t i = 0; i <= last; i++) { // one pass serves every root; nodes none of them use are skipped
+			if (needed[i]) { evaluate_node(i, context, values.data()); }
+		}
+		for (std::size_t k = 0; k < ids.size(); k++) { result[k] = values[ids[k]]; }
+		return result;
+	}
+
+	std::unique_ptr<unit> circuit_dag::to_unit(std::size_t id) const
+	{
+		if (id >= size()) { throw std::out_of_range("circuit_dag: no node with id " + std::to_string(id)); }
+		// iterative so deep trees cannot overflow the call stack; finished subtrees wait on built until their parent is done
+		struct frame { std::size_t id; std::size_t next_child; };
+		std::vector<frame> pending{ { id, 0 } };
+		std::vector<std::unique_ptr<unit>> built;
+		while (!pending.empty()) {
+			frame& top = pending.back();
+			unit_kind kind = get_kind(top.id);
+			double c = characteristics[top.id];
+			if (kind == unit_kind::series || kind == unit_kind::parallel) {
+				if (top.next_child < get_arity(top.id)) {
+					std::size_t child = get_child(top.id, top.next_child++);
+					pending.push_back({ child, 0 }); // top is invalidated here
+					continue;
+				}
+				auto first = built.end() - get_arity(top.id);
+				std::vector<std::unique_ptr<unit>> children(std::make_move_iterator(first), std::make_move_iterator(built.end()));
+				built.erase(first, built.end());
+				if (kind == unit_kind::series) { built.push_back(std::make_unique<series_circuit>(std::move(children))); }
+				else { built.push_back(std::make_unique<parallel_circuit>(std::move(children))); }
+			}
+			else if (kind == unit_kind::resistor) { built.push_back(std::make_unique<resistor>(c)); }
+			else if (kind == unit_kind::inductor) { built.push_back(std::make_unique<inductor>(c)); }
+			else { built.push_back(std::make_unique<capacitor>(c)); }
+			pending.pop_back();
+		}
+		return std::move(built.back());
+	}
+}
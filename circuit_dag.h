@@ -0,0 +1,67 @@
+// header file for the shared (hash-consed) form of unit trees. Structurally identical subtrees - same component kinds
+// and characteristics, same series/parallel nesting, children in the same order - are stored once, so a subcircuit
+// reused a thousand times costs one node and is evaluated once per frequency. Several trees, e.g. a whole master list,
+// can go into one circuit_dag and share subtrees with each other.
+#pragma once
+#ifndef circuit_dag_h
+#define circuit_dag_h
+
+#include <complex>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include "unit_class.h"
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	class circuit_dag
+	{
+	private:
+		std::vector<std::uint8_t> kinds; // per unique node, children always before their parents
+		std::vector<double> characteristics;
+		std::vector<std::uint32_t> first_child; // children of node i are child_ids[first_child[i] .. first_child[i + 1])
+		std::vector<std::uint32_t> child_ids;
+		std::vector<std::uint64_t> hashes; // structural hash of each node, kept so rehashing and lookups need no recomputation
+		std::vector<std::uint32_t> table; // open-addressing hash table of node ids; empty slots hold no_node
+		std::size_t added{ 0 }; // nodes passed in, before sharing
+
+		std::uint32_t intern(std::uint8_t kind, double characteristic, const std::uint32_t* children, std::size_t count);
+		void grow_table();
+		void evaluate_node(std::size_t i, const eval_context& context, std::complex<double>* values) const; // children already done
+		std::size_t mark_reachable(const std::vector<std::size_t>& ids, std::vector<char>& needed) const;
+		// sets needed[i] for every node some id depends on, and returns the largest id; throws std::out_of_range for an
+		// id that is not a node
+	public:
+		static constexpr std::uint32_t no_node{ 0xFFFFFFFFu };
+
+		circuit_dag();
+
+		std::size_t add(const flat_view& circuit); // returns the id of the root; no_node for an empty view
+		std::size_t add(const unit& root);
+
+		std::size_t size() const { return kinds.size(); } // unique nodes
+		std::size_t added_nodes() const { return added; } // nodes in all the trees added, counting every copy
+		std::size_t memory_bytes() const; // heap bytes held by the shared form
+
+		unit_kind get_kind(std::size_t id) const { return static_cast<unit_kind>(kinds[id]); }
+		double get_characteristic(std::size_t id) const { return characteristics[id]; }
+		std::size_t get_arity(std::size_t id) const { return first_child[id + 1] - first_child[id]; }
+		std::size_t get_child(std::size_t id, std::size_t index) const { return child_ids[first_child[id] + index]; }
+
+		void evaluate(const eval_context& context, std::size_t last, std::complex<double>* values) const;
+		// impedance of every node up to and including id last, each computed once; values needs room for last + 1.
+		// Throws std::out_of_range if last is not below size()
+		std::complex<double> get_impedance(std::size_t id, const eval_context& context) const;
+		std::vector<std::complex<double>> get_impedances(const std::vector<std::size_t>& ids, const eval_context& context) const;
+		// bit-for-bit what get_impedance on the original trees gives, since the arithmetic and child order are the same.
+		// Only the nodes the requested ids depend on are evaluated, each once, so several roots are cheapest asked for
+		// together. Throws std::out_of_range if an id is not below size(), no_node included
+
+		std::unique_ptr<unit> to_unit(std::size_t id) const; // expands a node back into an ordinary tree, copying shared parts
+		// throws std::out_of_range if id is not below size(), no_node included
+	};
+}
+
+#endif
@@ -0,0 +1,51 @@
+// header file for a counter-based random number generator (Philox4x32-10, Salmon et al., SC'11). The output depends only
+// on the key (seed) and a counter, so any thread can jump straight to the numbers for, say, node 1234 of a tree without
+// generating everything before it, which is what makes parallel generation reproducible.
+#pragma once
+#ifndef counter_rng_h
+#define counter_rng_h
+
+#include <cstdint>
+#include <array>
+
+namespace unit_namespace {
+
+	inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+	{
+		for (int round = 0; round < 10; round++) {
+			std::uint64_t product0 = std::uint64_t{ 0xD2511F53u } * counter[0];
+			std::uint64_t product1 = std::uint64_t{ 0xCD9E8D57u } * counter[2];
+			counter = { static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0], static_cast<std::uint32_t>(product1),
+				static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1], static_cast<std::uint32_t>(product0) };
+			key[0] += 0x9E3779B9u; key[1] += 0xBB67AE85u;
+		}
+		return counter;
+	}
+
+	class counter_stream // the sequence of random numbers belonging to one (seed, stream) pair, e.g. one tree node
+	{
+	private:
+		std::array<std::uint32_t, 2> key;
+		std::uint64_t stream;
+		std::uint32_t block{ 0 };
+		std::array<std::uint32_t, 4> buffer{};
+		int used{ 4 };
+	public:
+		counter_stream(std::uint64_t seed, std::uint64_t stream_id)
+			: key{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) }, stream{ stream_id } {}
+
+		std::uint32_t next_u32()
+		{
+			if (used == 4) {
+				buffer = philox4x32({ static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32), block++, 0 }, key);
+				used = 0;
+			}
+			return buffer[used++];
+		}
+		std::uint64_t next_u64() { std::uint64_t high = next_u32(); return (high << 32) | next_u32(); }
+		double next_double() { return (static_cast<double>(next_u64() >> 11) + 0.5) * 0x1.0p-53; } // uniform in (0, 1)
+		std::uint64_t next_below(std::uint64_t bound) { return static_cast<std::uint64_t>(next_double() * bound); } // [0, bound)
+	};
+}
+
+#endif
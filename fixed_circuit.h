@@ -0,0 +1,129 @@
+// header file for circuits whose topology is fixed in code. fixed::series(fixed::resistor{ 50 },
+// fixed::parallel(fixed::capacitor{ 1e-6 }, fixed::inductor{ 1e-3 })) builds a value whose type spells out the whole
+// tree, so get_impedance compiles to straight-line arithmetic with no heap, no pointers and no virtual calls, and can run
+// at compile time. to_unit() turns it into an ordinary unit tree when the rest of the program needs one.
+// Results equal the unit tree's to rounding: reciprocals are taken as (a - jb)/(a^2 + b^2), as in the vectorized sweep,
+// rather than by std::complex division, which is not constexpr. Where a^2 + b^2 is zero or infinite (a shorted member,
+// a capacitor at omega = 0) they follow std::complex division instead, so those cases give the unit tree's values too.
+#pragma once
+#ifndef fixed_circuit_h
+#define fixed_circuit_h
+
+#include <complex>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <limits>
+#include <cstddef>
+#include "unit_class.h"
+
+namespace unit_namespace {
+	namespace fixed {
+
+		template<unit_kind Kind> struct component
+		{
+			double characteristic; // ohms, henries or farads, as for the unit classes
+
+			constexpr std::complex<double> get_impedance(const eval_context& context) const
+			{
+				if constexpr (Kind == unit_kind::resistor) { return { characteristic, 0 }; }
+				else if constexpr (Kind == unit_kind::inductor) { return { 0, characteristic * context.omega }; }
+				else { return { 0, -1. / (characteristic * context.omega) }; }
+			}
+
+			static constexpr std::size_t size() { return 1; } // units in the equivalent unit tree
+
+			std::unique_ptr<unit> to_unit() const
+			{
+				if constexpr (Kind == unit_kind::resistor) { return std::make_unique<unit_namespace::resistor>(characteristic); }
+				else if constexpr (Kind == unit_kind::inductor) { return std::make_unique<unit_namespace::inductor>(characteristic); }
+				else { return std::make_unique<unit_namespace::capacitor>(characteristic); }
+			}
+		};
+
+		using resistor = component<unit_kind::resistor>;
+		using inductor = component<unit_kind::inductor>;
+		using capacitor = component<unit_kind::capacitor>;
+
+		template<unit_kind Kind, typename... Parts> struct group // a series or parallel circuit of the parts, in order
+		{
+			std::tuple<Parts...> parts;
+
+			constexpr std::complex<double> get_impedance(const eval_context& context) const
+			{
+				return std::apply([&](const Parts&... part) {
+					if constexpr (Kind == unit_kind::series) {
+						double re{ 0 }, im{ 0 };
+						(add(part.get_impedance(context), re, im), ...);
+						return std::complex<double>{ re, im };
+					}
+					else {
+						double re{ 0 }, im{ 0 };
+						(add_reciprocal(part.get_impedance(context), re, im), ...);
+						return reciprocal(re, im);
+					}
+				}, parts);
+			}
+
+			static constexpr std::size_t size() { return 1 + (Parts::size() + ...); }
+
+			std::unique_ptr<unit> to_unit() const
+			{
+				std::vector<std::unique_ptr<unit>> children;
+				children.reserve(sizeof...(Parts));
+				std::apply([&](const Parts&... part) { (children.push_back(part.to_unit()), ...); }, parts);
+				if constexpr (Kind == unit_kind::series) { return std::make_unique<series_circuit>(std::move(children)); }
+				else { return std::make_unique<parallel_circuit>(std::move(children)); }
+			}
+
+		private:
+			static constexpr std::complex<double> reciprocal(double re, double im)
+			{
+				double d = re * re + im * im;
+				if (d > 0 && d < infinity) { return { re / d, -im / d }; }
+				return exceptional_reciprocal(re, im);
+			}
+			static constexpr std::complex<double> exceptional_reciprocal(double re, double im)
+			// a^2 + b^2 zero, infinite or NaN: what std::complex division gives (C Annex G), so a shorted member makes a
+			// parallel circuit 0 and an open one (a capacitor at omega = 0) drops out, as in the unit tree
+			{
+				bool infinite_re = re == infinity || re == -infinity, infinite_im = im == infinity || im == -infinity;
+				if (infinite_re || infinite_im) { return { 0, 0 }; } // infinite, even with a NaN part
+				if (re != re || im != im) { return { quiet_nan, quiet_nan }; }
+				if (re == 0 && im == 0) { return { infinity, quiet_nan }; } // a short; the sum it goes into becomes infinite
+				double m = (re < 0 ? -re : re) > (im < 0 ? -im : im) ? (re < 0 ? -re : re) : (im < 0 ? -im : im);
+				double r = re / m, i = im / m, scaled = r * r + i * i; // a^2 + b^2 overflowed or underflowed; scale first
+				return { r / scaled / m, -i / scaled / m };
+			}
+			static constexpr double infinity{ std::numeric_limits<double>::infinity() };
+			static constexpr double quiet_nan{ std::numeric_limits<double>::quiet_NaN() };
+			static constexpr void add(const std::complex<double>& z, double& re, double& im) { re += z.real(); im += z.imag(); }
+			static constexpr void add_reciprocal(const std::complex<double>& z, double& re, double& im)
+			{
+				add(reciprocal(z.real(), z.imag()), re, im);
+			}
+		};
+
+		template<typename T> struct is_part : std::false_type {};
+		template<unit_kind Kind> struct is_part<component<Kind>> : std::true_type {};
+		template<unit_kind Kind, typename... Parts> struct is_part<group<Kind, Parts...>> : std::true_type {};
+
+		template<typename... Parts> constexpr group<unit_kind::series, Parts...> series(const Parts&... parts)
+		{
+			static_assert(sizeof...(Parts) > 0, "a series circuit needs at least one part");
+			static_assert((is_part<Parts>::value && ...), "series() takes fixed components and circuits only");
+			return { std::tuple<Parts...>{ parts... } };
+		}
+
+		template<typename... Parts> constexpr group<unit_kind::parallel, Parts...> parallel(const Parts&... parts)
+		{
+			static_assert(sizeof...(Parts) > 0, "a parallel circuit needs at least one part");
+			static_assert((is_part<Parts>::value && ...), "parallel() takes fixed components and circuits only");
+			return { std::tuple<Parts...>{ parts... } };
+		}
+	}
+}
+
+#endif
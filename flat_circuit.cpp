@@ -0,0 +1,114 @@
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	double flat_characteristic(const unit& component)
+	{
+		switch (component.get_kind()) {
+		case unit_kind::resistor: return static_cast<const resistor&>(component).get_characteristic();
+		case unit_kind::inductor: return static_cast<const inductor&>(component).get_characteristic();
+		case unit_kind::capacitor: return static_cast<const capacitor&>(component).get_characteristic();
+		default: return 0;
+		}
+	}
+
+	flat_circuit::flat_circuit(const unit& root)
+	{
+		// iterative postorder walk so very deep trees cannot overflow the call stack
+		struct frame { const unit* node; std::size_t next_child; };
+		std::vector<frame> pending{ { &root, 0 } };
+		std::size_t depth{ 0 };
+
+		while (!pending.empty()) {
+			frame& top = pending.back();
+			unit_kind kind = top.node->get_kind();
+			if (kind == unit_kind::series || kind == unit_kind::parallel) {
+				const auto& children = static_cast<const circuit*>(top.node)->get_units();
+				if (top.next_child < children.size()) {
+					const unit* child = children[top.next_child++].get();
+					pending.push_back({ child, 0 }); // top is invalidated here
+					continue;
+				}
+				kinds.push_back(static_cast<std::uint8_t>(kind));
+				characteristics.push_back(0);
+				arities.push_back(static_cast<std::uint32_t>(children.size()));
+				depth = depth - children.size() + 1; // children are replaced on the stack by their combination
+			}
+			else {
+				kinds.push_back(static_cast<std::uint8_t>(kind));
+				characteristics.push_back(flat_characteristic(*top.node));
+				arities.push_back(0);
+				depth++;
+			}
+			if (depth > max_stack) { max_stack = depth; }
+			pending.pop_back();
+		}
+	}
+
+	flat_view flat_circuit::view() const
+	{
+		flat_view v;
+		v.size = kinds.size(); v.max_stack = max_stack;
+		v.kinds = kinds.data(); v.characteristics = characteristics.data(); v.arities = arities.data();
+		return v;
+	}
+
+	std::complex<double> flat_view::get_impedance(const eval_context& context) const
+	{
+		std::vector<std::complex<double>> stack(max_stack);
+		return get_impedance(context, stack.data());
+	}
+
+	std::complex<double> flat_view::get_impedance(const eval_context& context, std::complex<double>* stack) const
+	{
+		// the arithmetic below deliberately mirrors the recursive get_impedance implementations operation for operation
+		// so that both paths round identically
+		std::size_t top{ 0 };
+		for (std::size_t i = 0; i < size; i++) {
+			double c = characteristics[i];
+			switch (static_cast<unit_kind>(kinds[i])) {
+			case unit_kind::resistor: stack[top++] = std::complex<double>{ c, 0 }; break;
+			case unit_kind::inductor: stack[top++] = std::complex<double>{ 0, c * context.omega }; break;
+			case unit_kind::capacitor: stack[top++] = std::complex<double>{ 0, -1. / (c * context.omega) }; break;
+			case unit_kind::series: {
+				std::size_t first = top - arities[i]; std::complex<double> sum;
+				for (std::size_t j = first; j < top; j++)
+					sum += stack[j];
+				top = first; stack[top++] = sum;
+				break;
+			}
+			case unit_kind::parallel: {
+				std::size_t first = top - arities[i]; std::complex<double> sum;
+				for (std::size_t j = first; j < top; j++)
+					sum += 1. / stack[j];
+				top = first; stack[top++] = 1. / sum;
+				break;
+			}
+			}
+		}
+		return top == 0 ? std::complex<double>{} : stack[0];
+	}
+
+	std::unique_ptr<unit> flat_view::to_unit() const
+	{
+		std::vector<std::unique_ptr<unit>> stack;
+		for (std::size_t i = 0; i < size; i++) {
+			unit_kind kind = static_cast<unit_kind>(kinds[i]);
+			switch (kind) {
+			case unit_kind::resistor: stack.push_back(std::make_unique<resistor>(characteristics[i])); break;
+			case unit_kind::inductor: stack.push_back(std::make_unique<inductor>(characteristics[i])); break;
+			case unit_kind::capacitor: stack.push_back(std::make_unique<capacitor>(characteristics[i])); break;
+			case unit_kind::series:
+			case unit_kind::parallel: {
+				auto first = stack.end() - arities[i];
+				std::vector<std::unique_ptr<unit>> children(std::make_move_iterator(first), std::make_move_iterator(stack.end()));
+				stack.erase(first, stack.end());
+				if (kind == unit_kind::series) { stack.push_back(std::make_unique<series_circuit>(std::move(children))); }
+				else { stack.push_back(std::make_unique<parallel_circuit>(std::move(children))); }
+				break;
+			}
+			}
+		}
+		return stack.empty() ? nullptr : std::move(stack.back());
+	}
+}
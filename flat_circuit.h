@@ -0,0 +1,57 @@
+// header file for the flattened ("compiled") form of a unit tree. The tree is stored as contiguous arrays in postorder
+// (kind, characteristic, number of children) so its impedance can be found in one linear pass with no virtual calls.
+#pragma once
+#ifndef flat_circuit_h
+#define flat_circuit_h
+
+#include <complex>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include "unit_class.h"
+
+namespace unit_namespace {
+
+	struct flat_view // non-owning view of flattened arrays, so the evaluator can also run over memory it does not own
+	{
+		std::size_t size{ 0 }; // number of nodes
+		std::size_t max_stack{ 0 }; // deepest the evaluation stack gets
+		const std::uint8_t* kinds{ nullptr }; // unit_kind of each node
+		const double* characteristics{ nullptr }; // component value; unused for circuits
+		const std::uint32_t* arities{ nullptr }; // number of direct children; zero for components
+
+		std::complex<double> get_impedance(const eval_context& context) const;
+		std::complex<double> get_impedance(const eval_context& context, std::complex<double>* stack) const;
+		// stack must have room for max_stack values; lets callers evaluating many times reuse one buffer
+		std::unique_ptr<unit> to_unit() const; // rebuilds the equivalent dynamic unit tree
+	};
+
+	class flat_circuit
+	{
+	private:
+		std::vector<std::uint8_t> kinds;
+		std::vector<double> characteristics;
+		std::vector<std::uint32_t> arities;
+		std::size_t max_stack{ 0 };
+	public:
+		flat_circuit() = default;
+		explicit flat_circuit(const unit& root); // walks the tree once; gives bit-for-bit the same results as root.get_impedance()
+
+		std::size_t size() const { return kinds.size(); }
+		flat_view view() const;
+		std::complex<double> get_impedance(const eval_context& context) const { return view().get_impedance(context); }
+
+		unit_kind get_kind(std::size_t i) const { return static_cast<unit_kind>(kinds[i]); }
+		double get_characteristic(std::size_t i) const { return characteristics[i]; }
+		std::uint32_t get_arity(std::size_t i) const { return arities[i]; }
+		void set_characteristic(std::size_t i, double c) { characteristics[i] = c; }
+		// for components only; keeps the flattened copy in step with an edit to the tree without walking it again
+
+		std::unique_ptr<unit> to_unit() const { return view().to_unit(); }
+	};
+
+	double flat_characteristic(const unit& component); // characteristic of a resistor, inductor or capacitor
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include "instrument.h"
+#include "unit_class.h"
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+
+namespace unit_namespace {
+
+	namespace instrument {
+
+		namespace {
+			constexpr std::size_t buckets{ 64 }; // latency bucket b > 0 holds durations in [2^(b-1), 2^b) ns; bucket 0 holds 0 ns
+			const char* const counter_names[counters]{ "evaluations", "allocations", "clones", "prints" };
+			const char* const operation_names[operations]{ "evaluate", "clone", "sweep", "print" };
+			const char* const kind_names[kinds]{ "resistor", "inductor", "capacitor", "series", "parallel" };
+
+			struct trace_event { const char* name; operation what; std::int64_t start_ns, duration_ns; };
+
+			struct thread_record
+			{
+				// written only by the owning thread (load then store, no locked instruction); read by anyone
+				std::atomic<std::uint64_t> counts[counters][kinds]{};
+				std::atomic<std::uint64_t> latency[operations][buckets]{};
+				std::atomic<std::uint64_t> total_ns[operations]{}, longest_ns[operations]{};
+				std::atomic<std::uint64_t> deepest{ 0 }, widest{ 0 };
+				std::mutex events_mutex; // only taken while tracing
+				std::vector<trace_event> events;
+				unsigned nesting[operations]{}; // private to the owning thread
+				std::uint64_t depth{ 0 };
+				std::uint32_t id{ 0 };
+			};
+
+			std::mutex& registry_mutex() { static std::mutex m; return m; }
+			std::vector<std::shared_ptr<thread_record>>& registry() { static std::vector<std::shared_ptr<thread_record>> r; return r; } // outlives its threads
+			std::atomic<bool> trace_on{ false };
+
+			std::chrono::steady_clock::time_point epoch()
+			{
+				static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				return start;
+			}
+
+			thread_record& local()
+			{
+				thread_local std::shared_ptr<thread_record> mine = [] {
+					auto record = std::make_shared<thread_record>();
+					std::lock_guard<std::mutex> lock(registry_mutex());
+					record->id = static_cast<std::uint32_t>(registry().size() + 1);
+					registry().push_back(record);
+					return record;
+				}();
+				return *mine;
+			}
+
+			void bump(std::atomic<std::uint64_t>& value, std::uint64_t by) noexcept
+			{
+				value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+			}
+
+			void raise(std::atomic<std::uint64_t>& value, std::uint64_t to) noexcept
+			{
+				if (to > value.load(std::memory_order_relaxed)) { value.store(to, std::memory_order_relaxed); }
+			}
+
+			std::size_t bucket_of(std::uint64_t ns)
+			{
+				std::size_t b{ 0 };
+				while (ns != 0 && b + 1 < buckets) { ns >>= 1; b++; }
+				return b;
+			}
+
+			template <typename Read> std::uint64_t total(Read read) // sums one field over every thread's record
+			{
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				std::uint64_t sum{ 0 };
+				for (const auto& record : registry()) { sum += read(*record); }
+				return sum;
+			}
+
+			void write_escaped(std::ostream& out, const char* text)
+			{
+				for (; *text != '\0'; text++) {
+					if (*text == '"' || *text == '\\') { out << '\\'; }
+					out << *text;
+				}
+			}
+		}
+
+		void count(counter what, unit_kind kind) noexcept
+		{
+			bump(local().counts[static_cast<std::size_t>(what)][static_cast<std::size_t>(kind)], 1);
+		}
+
+		shape_scope::shape_scope(std::size_t width) noexcept
+		{
+			thread_record& record = local();
+			record.depth++;
+			raise(record.deepest, record.depth);
+			raise(record.widest, width);
+		}
+
+		shape_scope::~shape_scope() { local().depth--; }
+
+		scoped_timer::scoped_timer(operation w, const char* n) noexcept
+			: what{ w }, name{ n }, outermost{ local().nesting[static_cast<std::size_t>(w)]++ == 0 }, start{ std::chrono::steady_clock::now() } {}
+
+		scoped_timer::~scoped_timer()
+		{
+			auto finish = std::chrono::steady_clock::now();
+			thread_record& record = local();
+			std::size_t op = static_cast<std::size_t>(what);
+			record.nesting[op]--;
+			if (!outermost) { return; }
+			std::uint64_t ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count());
+			bump(record.latency[op][bucket_of(ns)], 1);
+			bump(record.total_ns[op], ns);
+			raise(record.longest_ns[op], ns);
+			if (trace_on.load(std::memory_order_relaxed)) {
+				std::int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch()).count();
+				std::lock_guard<std::mutex> lock(record.events_mutex);
+				record.events.push_back({ name, what, offset, static_cast<std::int64_t>(ns) });
+			}
+		}
+
+		void set_tracing(bool on) { epoch(); trace_on.store(on); }
+		bool tracing() { return trace_on.load(); }
+
+		void reset() // meant for between runs; increments racing with it may survive
+		{
+			std::lock_guard<std::mutex> lock(registry_mutex());
+			for (const auto& record : registry()) {
+				for (auto& row : record->counts) { for (auto& c : row) { c.store(0); } }
+				for (auto& row : record->latency) { for (auto& c : row) { c.store(0); } }
+				for (auto& c : record->total_ns) { c.store(0); }
+				for (auto& c : record->longest_ns) { c.store(0); }
+				record->deepest.store(0); record->widest.store(0);
+				std::lock_guard<std::mutex> events_lock(record->events_mutex);
+				record->events.clear();
+			}
+		}
+
+		std::uint64_t get_count(counter what, unit_kind kind)
+		{
+			return total([&](const thread_record& r) { return r.counts[static_cast<std::size_t>(what)][static_cast<std::size_t>(kind)].load(); });
+		}
+
+		std::uint64_t get_calls(operation what)
+		{
+			std::uint64_t calls{ 0 };
+			for (std::size_t b = 0; b < buckets; b++) {
+				calls += total([&](const thread_record& r) { return r.latency[static_cast<std::size_t>(what)][b].load(); });
+			}
+			return calls;
+		}
+
+		double get_percentile(operation what, double q)
+		{
+			std::uint64_t histogram[buckets]{}, calls{ 0 };
+			for (std::size_t b = 0; b < buckets; b++) {
+				histogram[b] = total([&](const thread_record& r) { return r.latency[static_cast<std::size_t>(what)][b].load(); });
+				calls += histogram[b];
+			}
+			if (calls == 0) { return 0; }
+			std::uint64_t longest{ 0 };
+			{
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				for (const auto& record : registry()) { longest = std::max(longest, record->longest_ns[static_cast<std::size_t>(what)].load()); }
+			}
+			double rank = std::clamp(q, 0., 1.) * static_cast<double>(calls - 1), seen{ 0 }, edge{ 0 };
+			for (std::size_t b = 0; b < buckets; b++) {
+				seen += static_cast<double>(histogram[b]);
+				if (rank < seen) { edge = b == 0 ? 0 : std::ldexp(1., static_cast<int>(b)); break; }
+			}
+			return std::min(edge, static_cast<double>(longest)) * 1e-9; // the top bucket's edge can be past the slowest call
+		}
+
+		void write_stats(std::ostream& out)
+		{
+			if (!compiled_in) { out << "instrumentation not compiled in (build with UNIT_INSTRUMENT defined)" << std::endl; return; }
+			std::ios_base::fmtflags flags = out.flags();
+			out << std::left << std::setw(14) << "per node type";
+			for (const char* kind : kind_names) { out << std::right << std::setw(14) << kind; }
+			out << std::endl;
+			for (std::size_t c = 0; c < counters; c++) {
+				out << std::left << std::setw(14) << counter_names[c];
+				for (std::size_t k = 0; k < kinds; k++) { out << std::right << std::setw(14) << get_count(static_cast<counter>(c), static_cast<unit_kind>(k)); }
+				out << std::endl;
+			}
+			std::uint64_t deepest{ 0 }, widest{ 0 };
+			{
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				for (const auto& record : registry()) { deepest = std::max(deepest, record->deepest.load()); widest = std::max(widest, record->widest.load()); }
+			}
+			out << "deepest evaluation " << deepest << " circuits, widest circuit " << widest << " units" << std::endl;
+			out << std::left << std::setw(14) << "latency" << std::right << std::setw(12) << "calls" << std::setw(14) << "total ms"
+				<< std::setw(12) << "mean us" << std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+			for (std::size_t op = 0; op < operations; op++) {
+				operation what = static_cast<operation>(op);
+				std::uint64_t calls = get_calls(what);
+				std::uint64_t ns = total([&](const thread_record& r) { return r.total_ns[op].load(); }), longest{ 0 };
+				{
+					std::lock_guard<std::mutex> lock(registry_mutex());
+					for (const auto& record : registry()) { longest = std::max(longest, record->longest_ns[op].load()); }
+				}
+				out << std::left << std::setw(14) << operation_names[op] << std::right << std::setw(12) << calls
+					<< std::setw(14) << ns * 1e-6 << std::setw(12) << (calls ? ns * 1e-3 / calls : 0.)
+					<< std::setw(12) << get_percentile(what, 0.5) * 1e6 << std::setw(12) << get_percentile(what, 0.9) * 1e6
+					<< std::setw(12) << get_percentile(what, 0.99) * 1e6 << std::setw(12) << longest * 1e-3 << std::endl;
+			}
+			out.flags(flags);
+		}
+
+		void write_trace(std::ostream& out)
+		{
+			std::ios_base::fmtflags flags = out.flags();
+			std::streamsize precision = out.precision();
+			out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+			bool first{ true };
+			std::lock_guard<std::mutex> lock(registry_mutex());
+			for (const auto& record : registry()) {
+				std::lock_guard<std::mutex> events_lock(record->events_mutex);
+				for (const trace_event& e : record->events) {
+					out << (first ? "\n" : ",\n") << "{\"name\":\"";
+					write_escaped(out, e.name);
+					out << "\",\"cat\":\"" << operation_names[static_cast<std::size_t>(e.what)] << "\",\"ph\":\"X\",\"ts\":" << std::fixed << std::setprecision(3)
+						<< e.start_ns * 1e-3 << ",\"dur\":" << e.duration_ns * 1e-3 << ",\"pid\":1,\"tid\":" << record->id << "}";
+					first = false;
+				}
+			}
+			out << "\n]}" << std::endl;
+			out.flags(flags); out.precision(precision);
+		}
+	}
+}
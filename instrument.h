@@ -0,0 +1,87 @@
+// header file for the optional instrumentation of the hot paths: evaluations, allocations, clones and prints counted per
+// node type, the deepest and widest circuit evaluated, latency histograms for whole evaluate, clone, sweep and print
+// operations, and (when tracing is switched on) a timeline that loads into chrome://tracing or Perfetto.
+//
+// Compile with UNIT_INSTRUMENT defined to turn it on. Without it the UNIT_* macros below expand to nothing, so the
+// instrumented code compiles to exactly what it would be without them. The functions in the namespace are always
+// there, so callers need no #ifdefs; they simply report nothing when the macros are off.
+//
+// Each thread writes only to its own record, so counting costs a relaxed increment and no cache line is shared between
+// threads; reading the totals sums the records of every thread that has taken part.
+#pragma once
+#ifndef instrument_h
+#define instrument_h
+
+#include <ostream>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace unit_namespace {
+
+	enum class unit_kind : unsigned char; // defined in unit_class.h, which includes this file
+
+	namespace instrument {
+
+		enum class counter : unsigned char { evaluate, allocate, clone, print };
+		enum class operation : unsigned char { evaluate, clone, sweep, print };
+		constexpr std::size_t counters{ 4 }, operations{ 4 }, kinds{ 5 }; // kinds as in unit_kind
+
+#ifdef UNIT_INSTRUMENT
+		constexpr bool compiled_in{ true };
+#else
+		constexpr bool compiled_in{ false };
+#endif
+
+		void count(counter what, unit_kind kind) noexcept;
+
+		class shape_scope // one level of a recursive evaluation: tracks how deep evaluation goes and how wide circuits are
+		{
+		public:
+			explicit shape_scope(std::size_t width) noexcept;
+			~shape_scope();
+			shape_scope(const shape_scope&) = delete;
+			shape_scope& operator=(const shape_scope&) = delete;
+		};
+
+		class scoped_timer // times one operation; nested timers of the same operation on a thread count once, as the outermost
+		{
+		private:
+			operation what;
+			const char* name;
+			bool outermost;
+			std::chrono::steady_clock::time_point start;
+		public:
+			scoped_timer(operation what, const char* name) noexcept;
+			~scoped_timer();
+			scoped_timer(const scoped_timer&) = delete;
+			scoped_timer& operator=(const scoped_timer&) = delete;
+		};
+
+		void set_tracing(bool on); // keep a timeline event for every outermost timer; off by default, as it grows without bound
+		bool tracing();
+		void reset(); // zero every counter and histogram and drop the timeline
+
+		std::uint64_t get_count(counter what, unit_kind kind);
+		std::uint64_t get_calls(operation what);
+		double get_percentile(operation what, double q); // seconds; upper edge of the histogram bucket holding that quantile,
+		// so within a factor of two
+
+		void write_stats(std::ostream& out); // plain-text summary of everything above
+		void write_trace(std::ostream& out); // Chrome trace event format (JSON)
+	}
+}
+
+#ifdef UNIT_INSTRUMENT
+#define UNIT_INSTRUMENT_JOIN2(a, b) a##b
+#define UNIT_INSTRUMENT_JOIN(a, b) UNIT_INSTRUMENT_JOIN2(a, b)
+#define UNIT_COUNT(what, kind) ::unit_namespace::instrument::count(::unit_namespace::instrument::counter::what, kind)
+#define UNIT_TRACK_SHAPE(width) ::unit_namespace::instrument::shape_scope UNIT_INSTRUMENT_JOIN(unit_shape_, __LINE__)(width)
+#define UNIT_TIME(what, name) ::unit_namespace::instrument::scoped_timer UNIT_INSTRUMENT_JOIN(unit_timer_, __LINE__)(::unit_namespace::instrument::operation::what, name)
+#else
+#define UNIT_COUNT(what, kind) ((void)0)
+#define UNIT_TRACK_SHAPE(width) ((void)0)
+#define UNIT_TIME(what, name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace unit_namespace {
+
+#ifdef _WIN32
+	mapped_file::mapped_file(const std::string& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error("Cannot open " + path); }
+		file_handle = file;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size)) { close(); throw std::runtime_error("Cannot read the size of " + path); }
+		length = static_cast<std::size_t>(file_size.QuadPart);
+		if (length == 0) { return; } // an empty file cannot be mapped, but is still a valid (empty) file
+		mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr) { close(); throw std::runtime_error("Cannot map " + path); }
+		bytes = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (bytes == nullptr) { close(); throw std::runtime_error("Cannot map " + path); }
+	}
+
+	void mapped_file::close()
+	{
+		if (bytes != nullptr) { UnmapViewOfFile(bytes); }
+		if (mapping_handle != nullptr) { CloseHandle(mapping_handle); }
+		if (file_handle != nullptr) { CloseHandle(file_handle); }
+		bytes = nullptr; mapping_handle = nullptr; file_handle = nullptr; length = 0;
+	}
+#else
+	mapped_file::mapped_file(const std::string& path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) { throw std::runtime_error("Cannot open " + path); }
+		struct stat status;
+		if (::fstat(fd, &status) != 0) { ::close(fd); throw std::runtime_error("Cannot read the size of " + path); }
+		length = static_cast<std::size_t>(status.st_size);
+		if (length == 0) { ::close(fd); return; } // an empty file cannot be mapped, but is still a valid (empty) file
+		void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping keeps its own reference to the file
+		if (p == MAP_FAILED) { length = 0; throw std::runtime_error("Cannot map " + path); }
+		::madvise(p, length, MADV_SEQUENTIAL);
+		bytes = static_cast<const char*>(p);
+	}
+
+	void mapped_file::close()
+	{
+		if (bytes != nullptr) { ::munmap(const_cast<char*>(bytes), length); }
+		bytes = nullptr; length = 0;
+	}
+#endif
+
+	mapped_file::~mapped_file() { close(); }
+
+	mapped_file::mapped_file(mapped_file&& other) noexcept { *this = std::move(other); }
+
+	mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+	{
+		if (this != &other) {
+			close();
+			std::swap(bytes, other.bytes); std::swap(length, other.length);
+#ifdef _WIN32
+			std::swap(file_handle, other.file_handle); std::swap(mapping_handle, other.mapping_handle);
+#endif
+		}
+		return *this;
+	}
+}
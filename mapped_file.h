@@ -0,0 +1,36 @@
+// header file for a read-only memory-mapped file, so large netlists and snapshots can be read in place without copying
+// them into a buffer first.
+#pragma once
+#ifndef mapped_file_h
+#define mapped_file_h
+
+#include <string>
+#include <cstddef>
+
+namespace unit_namespace {
+
+	class mapped_file
+	{
+	private:
+		const char* bytes{ nullptr };
+		std::size_t length{ 0 };
+#ifdef _WIN32
+		void* file_handle{ nullptr };
+		void* mapping_handle{ nullptr };
+#endif
+		void close();
+	public:
+		mapped_file() = default;
+		explicit mapped_file(const std::string& path); // throws std::runtime_error if the file cannot be opened or mapped
+		~mapped_file();
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		mapped_file(mapped_file&& other) noexcept;
+		mapped_file& operator=(mapped_file&& other) noexcept;
+
+		const char* data() const { return bytes; }
+		std::size_t size() const { return length; }
+	};
+}
+
+#endif
@@ -0,0 +1,235 @@
+#include "mna_solver.h"
+
+#include <set>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	namespace {
+		class disjoint_sets
+		{
+		private:
+			std::vector<std::uint32_t> parent;
+		public:
+			explicit disjoint_sets(std::size_t count) : parent(count) { std::iota(parent.begin(), parent.end(), 0u); }
+			std::uint32_t find(std::uint32_t x)
+			{
+				while (parent[x] != x) { parent[x] = parent[parent[x]]; x = parent[x]; } // path halving
+				return x;
+			}
+			void join(std::uint32_t a, std::uint32_t b) { parent[find(a)] = find(b); }
+		};
+
+		bool is_short(const network_element& e) { return e.value == 0 && e.kind != unit_kind::capacitor; }
+		bool is_open(const network_element& e) { return e.value == 0 && e.kind == unit_kind::capacitor; }
+
+		std::vector<std::vector<std::uint32_t>> minimum_degree(std::vector<std::vector<std::uint32_t>> graph, std::vector<std::uint32_t>& order)
+		// eliminates the node of least degree each step, joining its neighbours into a clique as elimination does; returns
+		// the neighbours each node had when eliminated, which is the pattern of its column of L
+		{
+			std::size_t n = graph.size();
+			std::vector<std::vector<std::uint32_t>> pattern(n);
+			std::set<std::pair<std::size_t, std::uint32_t>> by_degree;
+			for (std::uint32_t v = 0; v < n; v++) { by_degree.insert({ graph[v].size(), v }); }
+			std::vector<std::uint32_t> merged;
+			order.clear();
+			while (!by_degree.empty()) {
+				std::uint32_t v = by_degree.begin()->second;
+				by_degree.erase(by_degree.begin());
+				order.push_back(v);
+				const std::vector<std::uint32_t>& clique = graph[v];
+				for (std::uint32_t u : clique) {
+					by_degree.erase({ graph[u].size(), u });
+					merged.clear();
+					std::set_union(graph[u].begin(), graph[u].end(), clique.begin(), clique.end(), std::back_inserter(merged));
+					merged.erase(std::remove_if(merged.begin(), merged.end(), [&](std::uint32_t w) { return w == u || w == v; }), merged.end());
+					graph[u].swap(merged);
+					by_degree.insert({ graph[u].size(), u });
+				}
+				pattern[v] = std::move(graph[v]);
+				graph[v].clear();
+			}
+			return pattern;
+		}
+
+		std::complex<double> admittance(unit_kind kind, double value, double omega)
+		{
+			switch (kind) {
+			case unit_kind::resistor: return { 1. / value, 0 };
+			case unit_kind::inductor: return { 0, -1. / (omega * value) };
+			default: return { 0, omega * value };
+			}
+		}
+
+		double relative_difference(std::complex<double> value, std::complex<double> reference)
+		{
+			if (value == reference) { return 0; }
+			double size = std::abs(reference), error = std::abs(value - reference);
+			if (!std::isfinite(error)) { return std::numeric_limits<double>::infinity(); }
+			return size == 0 ? error : error / size;
+		}
+	}
+
+	mna_solver::mna_solver(const network& circuit)
+	{
+		if (!circuit.port_set()) { throw std::invalid_argument("mna_solver: the network has no port"); }
+		const std::vector<network_element>& elements = circuit.get_elements();
+		std::size_t nodes = circuit.node_count();
+
+		disjoint_sets shorted(nodes), connected(nodes);
+		for (const network_element& e : elements) {
+			if (is_short(e)) { shorted.join(e.from, e.to); }
+			if (!is_open(e)) { connected.join(e.from, e.to); }
+		}
+		std::uint32_t reference = shorted.find(circuit.get_port_negative()), positive = shorted.find(circuit.get_port_positive());
+		std::uint32_t island = connected.find(reference);
+		port_open = connected.find(positive) != island;
+
+		// number the merged nodes in the reference's island, other than the reference itself
+		std::vector<std::int64_t> number(nodes, -1);
+		std::vector<std::vector<std::uint32_t>> graph;
+		for (std::uint32_t v = 0; v < nodes; v++) {
+			std::uint32_t root = shorted.find(v);
+			if (root == v && root != reference && connected.find(v) == island) { number[v] = static_cast<std::int64_t>(graph.size()); graph.emplace_back(); }
+		}
+		auto unknown = [&](std::uint32_t v) { return number[shorted.find(v)]; };
+		for (const network_element& e : elements) {
+			std::int64_t a = unknown(e.from), b = unknown(e.to);
+			if (is_open(e) || is_short(e) || a < 0 || b < 0 || a == b) { continue; }
+			graph[a].push_back(static_cast<std::uint32_t>(b)); graph[b].push_back(static_cast<std::uint32_t>(a));
+		}
+		for (auto& neighbours : graph) {
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		}
+		unknowns = graph.size();
+
+		// symbolic factorization: ordering, then the pattern of L in eliminated order, and its transpose
+		std::vector<std::uint32_t> order;
+		std::vector<std::vector<std::uint32_t>> pattern = minimum_degree(std::move(graph), order);
+		std::vector<std::uint32_t> position(unknowns);
+		for (std::uint32_t step = 0; step < unknowns; step++) { position[order[step]] = step; }
+		column_start.assign(unknowns + 1, 0);
+		for (std::size_t j = 0; j < unknowns; j++) { column_start[j + 1] = column_start[j] + pattern[order[j]].size(); }
+		row_index.resize(column_start.back());
+		for (std::size_t j = 0; j < unknowns; j++) {
+			std::uint32_t* rows = row_index.data() + column_start[j];
+			std::size_t count = pattern[order[j]].size();
+			for (std::size_t p = 0; p < count; p++) { rows[p] = position[pattern[order[j]][p]]; }
+			std::sort(rows, rows + count);
+			std::vector<std::uint32_t>().swap(pattern[order[j]]);
+		}
+		row_start.assign(unknowns + 1, 0);
+		for (std::uint32_t row : row_index) { row_start[row + 1]++; }
+		std::partial_sum(row_start.begin(), row_start.end(), row_start.begin());
+		row_column.resize(row_index.size()); row_position.resize(row_index.size());
+		std::vector<std::size_t> fill(row_start.begin(), row_start.end() - 1);
+		for (std::size_t k = 0; k < unknowns; k++) { // columns in increasing order, so each row's list ends up sorted
+			for (std::size_t p = column_start[k]; p < column_start[k + 1]; p++) {
+				std::size_t at = fill[row_index[p]]++;
+				row_column[at] = static_cast<std::uint32_t>(k); row_position[at] = p;
+			}
+		}
+
+		// where each element's admittance goes: both diagonals, and the one below-diagonal slot they share
+		for (const network_element& e : elements) {
+			std::int64_t a = unknown(e.from), b = unknown(e.to);
+			if (is_open(e) || is_short(e) || (a < 0 && b < 0) || a == b) { continue; }
+			std::int64_t pa = a < 0 ? -1 : static_cast<std::int64_t>(position[a]), pb = b < 0 ? -1 : static_cast<std::int64_t>(position[b]), slot{ -1 };
+			if (pa >= 0 && pb >= 0) {
+				std::int64_t column = std::min(pa, pb), row = std::max(pa, pb);
+				auto first = row_index.begin() + column_start[column], last = row_index.begin() + column_start[column + 1];
+				slot = std::lower_bound(first, last, static_cast<std::uint32_t>(row)) - row_index.begin();
+			}
+			stamps.push_back({ e.kind, e.value, pa, pb, slot });
+		}
+		if (!port_open && positive != reference) { port = position[number[positive]]; }
+	}
+
+	std::complex<double> mna_solver::solve(double omega, workspace& space) const
+	{
+		if (port_open) { return { std::numeric_limits<double>::infinity(), 0 }; }
+		if (port < 0) { return {}; } // the port is shorted
+		std::fill(space.factor.begin(), space.factor.end(), std::complex<double>{});
+		std::fill(space.ground.begin(), space.ground.end(), std::complex<double>{});
+		for (const stamp& s : stamps) {
+			std::complex<double> y = admittance(s.kind, s.value, omega);
+			if (s.slot >= 0) { space.factor[s.slot] -= y; }
+			else { space.ground[s.from >= 0 ? s.from : s.to] += y; } // element to the reference node
+		}
+
+		// left-looking L D L^T: column j gathers the updates from every earlier column with a nonzero in row j.
+		// The pivot is not taken from the updated diagonal but rebuilt from the row's admittance to the reference plus its
+		// remaining off-diagonal admittances (as in the GTH algorithm). Elimination is then the star-mesh transform and
+		// adds admittances rather than subtracting them, so a capacitor in series with a far larger inductor admittance
+		// is not lost to cancellation at low frequencies.
+		std::complex<double>* w = space.work.data();
+		std::complex<double>* values = space.factor.data();
+		for (std::size_t j = 0; j < unknowns; j++) {
+			std::complex<double> to_reference = space.ground[j];
+			for (std::size_t p = column_start[j]; p < column_start[j + 1]; p++) { w[row_index[p]] = values[p]; }
+			for (std::size_t r = row_start[j]; r < row_start[j + 1]; r++) {
+				std::size_t k = row_column[r], p = row_position[r]; // values[p] is L(j, k)
+				to_reference -= values[p] * space.ground[k];
+				std::complex<double> scale = values[p] * space.diagonal[k];
+				for (std::size_t q = p + 1; q < column_start[k + 1]; q++) { w[row_index[q]] -= scale * values[q]; } // rows > j of column k
+			}
+			std::complex<double> pivot = to_reference;
+			for (std::size_t p = column_start[j]; p < column_start[j + 1]; p++) { pivot -= w[row_index[p]]; }
+			space.ground[j] = to_reference; space.diagonal[j] = pivot;
+			for (std::size_t p = column_start[j]; p < column_start[j + 1]; p++) { values[p] = w[row_index[p]] / pivot; w[row_index[p]] = 0; }
+		}
+
+		// solve L D L^T v = e_port; the work vector is all zeros again here
+		w[port] = 1;
+		for (std::size_t j = 0; j < unknowns; j++) {
+			for (std::size_t p = column_start[j]; p < column_start[j + 1]; p++) { w[row_index[p]] -= values[p] * w[j]; }
+		}
+		for (std::size_t j = 0; j < unknowns; j++) { w[j] /= space.diagonal[j]; }
+		for (std::size_t j = unknowns; j-- > 0;) {
+			for (std::size_t p = column_start[j]; p < column_start[j + 1]; p++) { w[j] -= values[p] * w[row_index[p]]; }
+		}
+		std::complex<double> z = w[port];
+		std::fill(space.work.begin(), space.work.end(), std::complex<double>{});
+		return z;
+	}
+
+	std::complex<double> mna_solver::get_impedance(const eval_context& context) const
+	{
+		workspace space(row_index.size(), unknowns);
+		return solve(context.omega, space);
+	}
+
+	std::vector<std::complex<double>> mna_solver::sweep(const std::vector<double>& omegas) const
+	{
+		std::vector<std::complex<double>> result(omegas.size());
+		workspace space(row_index.size(), unknowns);
+		for (std::size_t k = 0; k < omegas.size(); k++) { result[k] = solve(omegas[k], space); }
+		return result;
+	}
+
+	std::vector<std::complex<double>> mna_solver::sweep(const std::vector<double>& omegas, thread_pool& pool, std::size_t chunk) const
+	{
+		std::vector<std::complex<double>> result(omegas.size());
+		pool.parallel_for(omegas.size(), chunk, [&](std::size_t begin, std::size_t end) {
+			workspace space(row_index.size(), unknowns);
+			for (std::size_t k = begin; k < end; k++) { result[k] = solve(omegas[k], space); }
+		});
+		return result;
+	}
+
+	double cross_check(const unit& root, const std::vector<double>& omegas)
+	{
+		mna_solver solver(to_network(root));
+		double worst{ 0 };
+		for (double omega : omegas) {
+			double difference = relative_difference(solver.get_impedance(eval_context{ omega }), root.get_impedance(eval_context{ omega }));
+			worst = std::max(worst, difference);
+		}
+		return worst;
+	}
+}
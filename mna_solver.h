@@ -0,0 +1,62 @@
+// header file for the sparse nodal solver for networks. The impedance at the port is found by driving 1 A into it and
+// solving Y v = i for the node voltages, where Y is the admittance matrix.
+//
+// For a network of two-terminal R, L and C elements this is the modified nodal analysis system with nothing left to
+// modify: the only elements MNA would give extra branch-current rows, zero-ohm resistors and zero-henry inductors, are
+// shorts, and those nodes are merged beforehand. Y is then complex symmetric, so it is factored as L D L^T. The
+// ordering (minimum degree) and the sparsity pattern of the factor depend only on the topology, so they are worked out
+// once in the constructor; each frequency only refills the numbers and refactors.
+#pragma once
+#ifndef mna_solver_h
+#define mna_solver_h
+
+#include <complex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "unit_class.h"
+#include "network.h"
+#include "thread_pool.h"
+
+namespace unit_namespace {
+
+	class mna_solver
+	{
+	private:
+		struct stamp { unit_kind kind; double value; std::int64_t from, to, slot; }; // -1 for the reference node; slot -1 if none
+		struct workspace // numeric storage for one factorization, so concurrent sweeps each get their own
+		{
+			std::vector<std::complex<double>> factor; // below-diagonal entries of L, column by column
+			std::vector<std::complex<double>> diagonal; // D
+			std::vector<std::complex<double>> ground; // each row's admittance to the reference node as elimination reaches it
+			std::vector<std::complex<double>> work; // dense scatter column, also the solution vector
+			workspace(std::size_t nonzeros, std::size_t unknowns) : factor(nonzeros), diagonal(unknowns), ground(unknowns), work(unknowns) {}
+		};
+
+		std::size_t unknowns{ 0 };
+		std::vector<std::size_t> column_start; // factor pattern: rows of column j are row_index[column_start[j] .. column_start[j + 1])
+		std::vector<std::uint32_t> row_index;
+		std::vector<std::size_t> row_start; // transposed pattern: the columns k < j with L(j, k) nonzero, and where that entry is
+		std::vector<std::uint32_t> row_column;
+		std::vector<std::size_t> row_position;
+		std::vector<stamp> stamps;
+		std::int64_t port{ -1 }; // position of the positive port node; -1 if it is the reference or not connected to it
+		bool port_open{ false }; // the port nodes are not connected, so the impedance is infinite
+
+		std::complex<double> solve(double omega, workspace& space) const;
+	public:
+		explicit mna_solver(const network& circuit); // throws std::invalid_argument if the network has no port
+
+		std::size_t size() const { return unknowns; } // equations after merging shorts and dropping unconnected nodes
+		std::size_t factor_nonzeros() const { return row_index.size(); } // below the diagonal of L, fill-in included
+
+		std::complex<double> get_impedance(const eval_context& context) const; // omega must be positive
+		std::vector<std::complex<double>> sweep(const std::vector<double>& omegas) const;
+		std::vector<std::complex<double>> sweep(const std::vector<double>& omegas, thread_pool& pool, std::size_t chunk = 16) const;
+	};
+
+	double cross_check(const unit& root, const std::vector<double>& omegas);
+	// largest relative difference between root.get_impedance and the solver on to_network(root), over the frequencies given
+}
+
+#endif
@@ -0,0 +1,246 @@
+#include "monte_carlo.h"
+#include "counter_rng.h"
+#include "sweep.h"
+
+#include <cmath>
+#include <mutex>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	namespace {
+		constexpr std::size_t trial_chunk{ 4096 }; // trials per parallel task; fixed so the merge order never depends on the pool
+		constexpr double pi{ 3.14159265358979323846 };
+
+		double unit_interval(std::uint32_t high, std::uint32_t low) // uniform in (0, 1)
+		{
+			return (static_cast<double>(((std::uint64_t{ high } << 32) | low) >> 11) + 0.5) * 0x1.0p-53;
+		}
+
+		double deviation(std::array<std::uint32_t, 2> key, std::uint64_t trial, std::size_t node, std::uint32_t attempt, tolerance_distribution distribution)
+		// relative deviation of one component in one trial, scaled so the tolerance limits are at +-1. node < 2^32, so
+		// the last counter word is free for attempt, which numbers the redraws of a value that came out non-positive
+		{
+			std::array<std::uint32_t, 4> bits = philox4x32({ static_cast<std::uint32_t>(trial), static_cast<std::uint32_t>(trial >> 32),
+				static_cast<std::uint32_t>(node), attempt }, key);
+			double u = unit_interval(bits[0], bits[1]);
+			if (distribution == tolerance_distribution::uniform) { return 2 * u - 1; }
+			return std::sqrt(-2 * std::log(u)) * std::cos(2 * pi * unit_interval(bits[2], bits[3])) / 3; // Box-Muller
+		}
+
+		double tolerance_of(unit_kind kind, const tolerance_options& tolerances)
+		{
+			switch (kind) {
+			case unit_kind::resistor: return tolerances.resistor;
+			case unit_kind::inductor: return tolerances.inductor;
+			default: return tolerances.capacitor;
+			}
+		}
+
+		void evaluate_trials(const flat_view& circuit, const monte_carlo_options& options, std::uint64_t first, std::size_t n,
+			double* stack_re, double* stack_im, double* real, double* imag)
+		// impedance of trials [first, first + n), n <= sweep_block; the stacks hold max_stack + 1 rows of sweep_block
+		{
+			if (circuit.size == 0) {
+				std::fill(real, real + n, 0.); std::fill(imag, imag + n, 0.);
+				return;
+			}
+			std::array<std::uint32_t, 2> key{ static_cast<std::uint32_t>(options.seed), static_cast<std::uint32_t>(options.seed >> 32) };
+			double* acc_re = stack_re + circuit.max_stack * sweep_block;
+			double* acc_im = stack_im + circuit.max_stack * sweep_block;
+			double omega = options.omega;
+			std::size_t top{ 0 };
+			for (std::size_t i = 0; i < circuit.size; i++) {
+				unit_kind kind = static_cast<unit_kind>(circuit.kinds[i]);
+				std::size_t arity = circuit.arities[i];
+				if (kind == unit_kind::series || kind == unit_kind::parallel) {
+					std::size_t first_child = top - arity;
+					sweep_combine(kind, arity, n, stack_re + first_child * sweep_block, stack_im + first_child * sweep_block, acc_re, acc_im);
+					top = first_child + 1;
+					continue;
+				}
+				double nominal = circuit.characteristics[i], tolerance = tolerance_of(kind, options.tolerances);
+				double* re = stack_re + top * sweep_block;
+				double* im = stack_im + top * sweep_block;
+				for (std::size_t t = 0; t < n; t++) {
+					double value = nominal;
+					for (std::uint32_t attempt = 0; nominal > 0; attempt++) { // a draw at or below zero is drawn again
+						value = nominal * (1 + tolerance * deviation(key, first + t, i, attempt, options.tolerances.distribution));
+						if (value > 0) { break; }
+					}
+					re[t] = kind == unit_kind::resistor ? value : 0;
+					im[t] = kind == unit_kind::inductor ? omega * value : kind == unit_kind::capacitor ? -1. / (omega * value) : 0;
+				}
+				top++;
+			}
+			std::copy(stack_re, stack_re + n, real);
+			std::copy(stack_im, stack_im + n, imag);
+		}
+	}
+
+	void running_moments::add(double x)
+	{
+		samples++;
+		if (samples == 1) { smallest = largest = x; }
+		else { smallest = std::min(smallest, x); largest = std::max(largest, x); }
+		double delta = x - average;
+		average += delta / static_cast<double>(samples);
+		squares += delta * (x - average);
+	}
+
+	void running_moments::merge(const running_moments& other)
+	{
+		if (other.samples == 0) { return; }
+		if (samples == 0) { *this = other; return; }
+		double a = static_cast<double>(samples), b = static_cast<double>(other.samples), total = a + b;
+		double delta = other.average - average;
+		average += delta * b / total;
+		squares += other.squares + delta * delta * a * b / total;
+		samples += other.samples;
+		smallest = std::min(smallest, other.smallest); largest = std::max(largest, other.largest);
+	}
+
+	quantile_sketch quantile_sketch::relative(double accuracy)
+	{
+		if (!(accuracy > 0 && accuracy < 1)) { throw std::invalid_argument("quantile_sketch: relative accuracy must be between 0 and 1"); }
+		quantile_sketch sketch;
+		sketch.logarithmic = true;
+		sketch.width = std::log((1 + accuracy) / (1 - accuracy)); // bucket (g^(k-1), g^k] reported as 2 g^k / (g + 1)
+		return sketch;
+	}
+
+	quantile_sketch quantile_sketch::absolute(double resolution)
+	{
+		if (!(resolution > 0) || !std::isfinite(resolution)) { throw std::invalid_argument("quantile_sketch: resolution must be positive"); }
+		quantile_sketch sketch;
+		sketch.width = resolution;
+		return sketch;
+	}
+
+	std::int64_t quantile_sketch::key(double x) const
+	{
+		double scaled = logarithmic ? std::ceil(std::log(x) / width) : std::floor(x / width);
+		return static_cast<std::int64_t>(std::clamp(scaled, -4e18, 4e18));
+	}
+
+	double quantile_sketch::representative(std::int64_t k) const
+	{
+		if (!logarithmic) { return (static_cast<double>(k) + 0.5) * width; }
+		double ratio = std::exp(width);
+		return 2 * std::exp(static_cast<double>(k) * width) / (ratio + 1);
+	}
+
+	void quantile_sketch::add_to_bucket(std::int64_t k, std::uint64_t count)
+	{
+		if (counts.empty()) { first_key = k; counts.push_back(count); return; }
+		if (k < first_key) { // grow downwards with some slack, so a slowly falling sequence does not shift the array every time
+			std::size_t grow = std::max(static_cast<std::size_t>(first_key - k), counts.size() / 2);
+			counts.insert(counts.begin(), grow, 0);
+			first_key -= static_cast<std::int64_t>(grow);
+		}
+		std::size_t at = static_cast<std::size_t>(k - first_key);
+		if (at >= counts.size()) { counts.resize(at + 1); }
+		counts[at] += count;
+	}
+
+	void quantile_sketch::add(double x)
+	{
+		if (!std::isfinite(x)) { not_finite++; }
+		else if (logarithmic && x <= 0) { zero_or_less++; }
+		else { add_to_bucket(key(x), 1); }
+	}
+
+	void quantile_sketch::merge(const quantile_sketch& other)
+	{
+		if (other.logarithmic != logarithmic || other.width != width) { throw std::invalid_argument("quantile_sketch: merging sketches with different buckets"); }
+		for (std::size_t k = 0; k < other.counts.size(); k++) {
+			if (other.counts[k] != 0) { add_to_bucket(other.first_key + static_cast<std::int64_t>(k), other.counts[k]); }
+		}
+		zero_or_less += other.zero_or_less;
+		not_finite += other.not_finite;
+	}
+
+	std::uint64_t quantile_sketch::count() const
+	{
+		std::uint64_t total = zero_or_less;
+		for (std::uint64_t c : counts) { total += c; }
+		return total;
+	}
+
+	double quantile_sketch::quantile(double q) const
+	{
+		std::uint64_t total = count();
+		if (total == 0) { return std::numeric_limits<double>::quiet_NaN(); }
+		double rank = std::clamp(q, 0., 1.) * static_cast<double>(total - 1); // the sample with this many below it
+		double seen = static_cast<double>(zero_or_less);
+		if (rank < seen) { return 0; }
+		for (std::size_t k = 0; k < counts.size(); k++) {
+			seen += static_cast<double>(counts[k]);
+			if (rank < seen) { return representative(first_key + static_cast<std::int64_t>(k)); }
+		}
+		return representative(first_key + static_cast<std::int64_t>(counts.size()) - 1);
+	}
+
+	double quantile_sketch::fraction_between(double low, double high) const
+	{
+		std::uint64_t total = count(), inside{ 0 };
+		if (total == 0) { return 0; }
+		if (low <= 0 && high >= 0) { inside += zero_or_less; }
+		for (std::size_t k = 0; k < counts.size(); k++) {
+			double value = representative(first_key + static_cast<std::int64_t>(k));
+			if (value >= low && value <= high) { inside += counts[k]; }
+		}
+		return static_cast<double>(inside) / static_cast<double>(total);
+	}
+
+	monte_carlo_result monte_carlo(const flat_view& circuit, const monte_carlo_options& options, thread_pool& pool)
+	{
+		const tolerance_options& t = options.tolerances;
+		for (double tolerance : { t.resistor, t.inductor, t.capacitor }) {
+			if (!(tolerance >= 0) || !std::isfinite(tolerance)) { throw std::invalid_argument("monte_carlo: tolerances must be finite and not negative"); }
+		}
+		if (!(options.omega > 0) || !std::isfinite(options.omega)) { throw std::invalid_argument("monte_carlo: omega must be positive"); }
+		if (circuit.size > std::numeric_limits<std::uint32_t>::max()) { throw std::invalid_argument("monte_carlo: circuit has too many nodes"); }
+
+		monte_carlo_result result;
+		result.trials = options.trials;
+		const quantile_sketch empty_magnitude = quantile_sketch::relative(options.magnitude_accuracy);
+		const quantile_sketch empty_phase = quantile_sketch::absolute(options.phase_resolution);
+		result.magnitude_distribution = empty_magnitude;
+		result.phase_distribution = empty_phase;
+
+		std::size_t pieces = static_cast<std::size_t>((options.trials + trial_chunk - 1) / trial_chunk);
+		std::vector<running_moments> magnitudes(pieces), phases(pieces); // merged in trial order afterwards, not as tasks finish
+		std::mutex merging;
+		pool.parallel_for(static_cast<std::size_t>(options.trials), trial_chunk, [&](std::size_t begin, std::size_t end) {
+			std::vector<double> stack_re((circuit.max_stack + 1) * sweep_block), stack_im((circuit.max_stack + 1) * sweep_block);
+			std::vector<double> real(sweep_block), imag(sweep_block);
+			quantile_sketch magnitude_sketch = empty_magnitude, phase_sketch = empty_phase;
+			running_moments& magnitude = magnitudes[begin / trial_chunk];
+			running_moments& phase = phases[begin / trial_chunk];
+			for (std::size_t start = begin; start < end; start += sweep_block) {
+				std::size_t n = std::min(sweep_block, end - start);
+				evaluate_trials(circuit, options, start, n, stack_re.data(), stack_im.data(), real.data(), imag.data());
+				for (std::size_t k = 0; k < n; k++) {
+					double m = std::sqrt(real[k] * real[k] + imag[k] * imag[k]), p = std::atan2(imag[k], real[k]);
+					magnitude.add(m); phase.add(p);
+					magnitude_sketch.add(m); phase_sketch.add(p);
+				}
+			}
+			std::lock_guard<std::mutex> lock(merging); // bucket counts are integers, so the order of these merges does not matter
+			result.magnitude_distribution.merge(magnitude_sketch);
+			result.phase_distribution.merge(phase_sketch);
+		});
+		for (std::size_t k = 0; k < pieces; k++) { result.magnitude.merge(magnitudes[k]); result.phase.merge(phases[k]); }
+		return result;
+	}
+
+	monte_carlo_result monte_carlo(const unit& root, const monte_carlo_options& options)
+	{
+		flat_circuit flat(root);
+		thread_pool pool(options.threads);
+		return monte_carlo(flat.view(), options, pool);
+	}
+}
@@ -0,0 +1,99 @@
+// header file for Monte Carlo tolerance analysis. Every resistor, inductor and capacitor value is varied within its
+// tolerance, independently per trial, and the distribution of the impedance's magnitude and phase is summarised.
+// The topology is flattened once; trials are evaluated a block at a time with each component's values for the whole
+// block held in contiguous arrays, so one traversal of the tree serves hundreds of trials. Samples are folded into
+// streaming statistics as they are produced, so memory does not grow with the number of trials.
+//
+// Component values come from a counter-based generator keyed by (seed, trial, node), and partial results are combined
+// in a fixed order, so a given seed gives exactly the same result on any number of threads.
+#pragma once
+#ifndef monte_carlo_h
+#define monte_carlo_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+#include "thread_pool.h"
+
+namespace unit_namespace {
+
+	class running_moments // count, mean, variance, minimum and maximum without keeping the samples (Welford)
+	{
+	private:
+		std::uint64_t samples{ 0 };
+		double average{ 0 }, squares{ 0 }; // squares is the sum of squared deviations from the mean
+		double smallest{ 0 }, largest{ 0 };
+	public:
+		void add(double x);
+		void merge(const running_moments& other); // as if other's samples had been added after this one's (Chan et al.)
+
+		std::uint64_t count() const { return samples; }
+		double mean() const { return average; }
+		double variance() const { return samples > 1 ? squares / static_cast<double>(samples - 1) : 0; } // sample variance
+		double minimum() const { return smallest; }
+		double maximum() const { return largest; }
+	};
+
+	class quantile_sketch // a histogram with fixed bucket edges, so sketches merge exactly and in any order
+	{
+	private:
+		bool logarithmic{ false }; // buckets of equal ratio (relative accuracy) rather than equal width
+		double width{ 1 }; // bucket width, or log of the bucket ratio
+		std::int64_t first_key{ 0 };
+		std::vector<std::uint64_t> counts; // counts[k] is bucket first_key + k
+		std::uint64_t zero_or_less{ 0 }; // logarithmic sketches cannot bucket these
+		std::uint64_t not_finite{ 0 }; // left out of the quantiles
+
+		std::int64_t key(double x) const;
+		double representative(std::int64_t key) const; // value reported for anything in that bucket
+		void add_to_bucket(std::int64_t key, std::uint64_t count);
+	public:
+		static quantile_sketch relative(double accuracy); // quantiles within that relative error, for positive values
+		static quantile_sketch absolute(double resolution); // quantiles within resolution / 2
+
+		void add(double x);
+		void merge(const quantile_sketch& other); // other must have been made the same way
+
+		std::uint64_t count() const; // finite samples
+		double quantile(double q) const; // q in [0, 1]; NaN if there are no finite samples
+		double fraction_between(double low, double high) const; // share of finite samples in [low, high], to bucket accuracy
+	};
+
+	enum class tolerance_distribution : unsigned char { uniform, normal };
+
+	struct tolerance_options
+	{
+		double resistor{ 0.05 }; // relative tolerance, e.g. 0.05 for 5%
+		double inductor{ 0.10 };
+		double capacitor{ 0.10 };
+		tolerance_distribution distribution{ tolerance_distribution::uniform }; // normal: the tolerance is three standard deviations
+		// a draw at or below zero (a tolerance of 1 or more, or the tail of the normal) is redrawn, so values stay
+		// positive; a component whose nominal value is 0 stays a short (or, for a capacitor, an open)
+	};
+
+	struct monte_carlo_options
+	{
+		std::uint64_t seed{ 0 };
+		std::uint64_t trials{ 100000 };
+		double omega{ 1 }; // rad/s
+		tolerance_options tolerances;
+		double magnitude_accuracy{ 1e-4 }; // relative accuracy of the magnitude percentiles
+		double phase_resolution{ 1e-4 }; // bucket width of the phase percentiles, in radians
+		std::size_t threads{ 0 }; // zero means one per hardware core; only used by the overload that makes its own pool
+	};
+
+	struct monte_carlo_result
+	{
+		std::uint64_t trials{ 0 };
+		running_moments magnitude, phase; // phase in radians
+		quantile_sketch magnitude_distribution, phase_distribution;
+	};
+
+	monte_carlo_result monte_carlo(const flat_view& circuit, const monte_carlo_options& options, thread_pool& pool);
+	monte_carlo_result monte_carlo(const unit& root, const monte_carlo_options& options);
+	// throws std::invalid_argument for a negative tolerance or a non-positive omega
+}
+
+#endif
@@ -0,0 +1,283 @@
+#include "netlist.h"
+#include "mapped_file.h"
+#include "buffered_writer.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace unit_namespace {
+
+	netlist_error::netlist_error(std::size_t line, const std::string& message)
+		: std::runtime_error("netlist line " + std::to_string(line) + ": " + message), line_number{ line } {}
+
+	namespace {
+
+		inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+		inline bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+		inline char lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+		bool equals_lower(std::string_view token, std::string_view word) // case-insensitive; word must be lower case
+		{
+			if (token.size() != word.size()) { return false; }
+			for (std::size_t i = 0; i < word.size(); i++) { if (lower(token[i]) != word[i]) { return false; } }
+			return true;
+		}
+
+		class line_reader // cursor over netlist text with the tokenizing shared by both netlist forms
+		{
+		protected:
+			const char* p;
+			const char* end;
+			std::size_t line{ 1 };
+
+			explicit line_reader(std::string_view text) : p{ text.data() }, end{ text.data() + text.size() } {}
+
+			[[noreturn]] void fail(const std::string& message) const { throw netlist_error(line, message); }
+
+			void skip_blanks() { while (p < end && is_blank(*p)) { p++; } }
+			void skip_line() { while (p < end && *p != '\n') { p++; } }
+
+			std::string_view next_token()
+			{
+				skip_blanks();
+				const char* start = p;
+				while (p < end && !is_blank(*p) && *p != '\n' && *p != ';') { p++; }
+				return std::string_view(start, static_cast<std::size_t>(p - start));
+			}
+
+			void expect_line_end() // only blanks or a trailing comment may follow
+			{
+				skip_blanks();
+				if (p < end && *p != '\n' && *p != ';') { fail("unexpected text after item"); }
+				skip_line();
+			}
+
+			double parse_value()
+			{
+				skip_blanks();
+				double value{ 0 };
+				auto parsed = std::from_chars(p, end, value);
+				if (parsed.ec != std::errc() || parsed.ptr == p) { fail("expected a component value"); }
+				p = parsed.ptr;
+				if (p < end && is_alpha(*p)) {
+					if (end - p >= 3 && lower(p[0]) == 'm' && lower(p[1]) == 'e' && lower(p[2]) == 'g') { value *= 1e6; p += 3; }
+					else {
+						switch (lower(*p)) {
+						case 'f': value *= 1e-15; p++; break;
+						case 'p': value *= 1e-12; p++; break;
+						case 'n': value *= 1e-9; p++; break;
+						case 'u': value *= 1e-6; p++; break;
+						case 'm': value *= 1e-3; p++; break;
+						case 'k': value *= 1e3; p++; break;
+						case 'g': value *= 1e9; p++; break;
+						case 't': value *= 1e12; p++; break;
+						default: break; // no scale, e.g. "Ohm" or "H"; "F" never gets here, it is femto
+						}
+					}
+					while (p < end && is_alpha(*p)) { p++; }
+				}
+				if (!std::isfinite(value) || value < 0) { fail("component values must be finite and not negative"); }
+				return value;
+			}
+
+			bool next_line_start(char& c) // skips blank lines and comments; false at the end of the text
+			{
+				while (p < end) {
+					skip_blanks();
+					if (p == end) { break; }
+					c = *p;
+					if (c == '\n') { p++; line++; continue; }
+					if (c == '*' || c == '#' || c == ';') { skip_line(); continue; }
+					return true;
+				}
+				return false;
+			}
+		};
+
+		class netlist_parser : line_reader
+		{
+		private:
+			std::vector<std::unique_ptr<unit>> items; // members of every open group, innermost last, above the top-level list
+			std::vector<std::size_t> group_starts; // index in items where each open group's members begin
+			std::vector<unit_kind> group_kinds;
+
+			void close_group()
+			{
+				if (group_kinds.empty()) { fail(".ends without a matching .series or .parallel"); }
+				auto first = items.begin() + static_cast<std::ptrdiff_t>(group_starts.back());
+				std::vector<std::unique_ptr<unit>> members(std::make_move_iterator(first), std::make_move_iterator(items.end()));
+				items.erase(first, items.end()); // members is sized exactly, and items keeps its capacity for the next group
+				if (group_kinds.back() == unit_kind::series) { items.push_back(std::make_unique<series_circuit>(std::move(members))); }
+				else { items.push_back(std::make_unique<parallel_circuit>(std::move(members))); }
+				group_starts.pop_back(); group_kinds.pop_back();
+			}
+
+		public:
+			explicit netlist_parser(std::string_view text) : line_reader(text) {}
+
+			void open_group(unit_kind kind) { group_starts.push_back(items.size()); group_kinds.push_back(kind); }
+
+			std::vector<std::unique_ptr<unit>> parse()
+			{
+				char c;
+				while (next_line_start(c)) {
+					std::string_view token = next_token();
+					switch (lower(c)) {
+					case 'r': items.push_back(std::make_unique<resistor>(parse_value())); expect_line_end(); break;
+					case 'l': items.push_back(std::make_unique<inductor>(parse_value())); expect_line_end(); break;
+					case 'c': items.push_back(std::make_unique<capacitor>(parse_value())); expect_line_end(); break;
+					case '.': {
+						std::string_view directive = token.substr(1);
+						if (equals_lower(directive, "series")) { open_group(unit_kind::series); expect_line_end(); }
+						else if (equals_lower(directive, "parallel")) { open_group(unit_kind::parallel); expect_line_end(); }
+						else if (equals_lower(directive, "ends")) { close_group(); expect_line_end(); }
+						else if (equals_lower(directive, "end")) { p = end; }
+						else { fail("unknown directive '" + std::string(token) + "'"); }
+						break;
+					}
+					default: fail("unknown item '" + std::string(token) + "'");
+					}
+				}
+				if (!group_kinds.empty()) { fail("missing .ends at end of netlist"); }
+				return std::move(items);
+			}
+		};
+
+		class network_parser : line_reader
+		{
+		private:
+			network result;
+			std::size_t port_line{ 0 };
+
+			std::string_view node_token()
+			{
+				std::string_view name = next_token();
+				if (name.empty()) { fail("expected a node name"); }
+				return name;
+			}
+
+		public:
+			explicit network_parser(std::string_view text) : line_reader(text) {}
+
+			network parse()
+			{
+				char c;
+				while (next_line_start(c)) {
+					std::string_view token = next_token();
+					switch (lower(c)) {
+					case 'r':
+					case 'l':
+					case 'c': {
+						unit_kind kind = lower(c) == 'r' ? unit_kind::resistor : lower(c) == 'l' ? unit_kind::inductor : unit_kind::capacitor;
+						std::string_view from = node_token(), to = node_token();
+						result.add(kind, from, to, parse_value());
+						expect_line_end();
+						break;
+					}
+					case '.': {
+						std::string_view directive = token.substr(1);
+						if (equals_lower(directive, "port")) {
+							if (port_line != 0) { fail(".port already given on line " + std::to_string(port_line)); }
+							std::string_view positive = node_token(), negative = node_token();
+							result.set_port(result.node(positive), result.node(negative));
+							port_line = line;
+							expect_line_end();
+						}
+						else if (equals_lower(directive, "end")) { p = end; }
+						else { fail("unknown directive '" + std::string(token) + "'"); }
+						break;
+					}
+					default: fail("unknown item '" + std::string(token) + "'");
+					}
+				}
+				if (port_line == 0) { fail("missing .port"); }
+				return std::move(result);
+			}
+		};
+
+		void write_tree(buffered_writer& out, const unit& root, std::size_t counts[3])
+		{
+			struct frame { const unit* node; std::size_t next_child; };
+			std::vector<frame> pending{ { &root, 0 } };
+			while (!pending.empty()) {
+				frame& top = pending.back();
+				unit_kind kind = top.node->get_kind();
+				if (kind == unit_kind::series || kind == unit_kind::parallel) {
+					const auto& children = static_cast<const circuit*>(top.node)->get_units();
+					if (top.next_child == 0) { out.put(kind == unit_kind::series ? ".series\n" : ".parallel\n"); }
+					if (top.next_child < children.size()) {
+						const unit* child = children[top.next_child++].get();
+						pending.push_back({ child, 0 }); // top is invalidated here
+						continue;
+					}
+					out.put(".ends\n");
+				}
+				else {
+					double value{ 0 };
+					switch (kind) {
+					case unit_kind::resistor: out.put('R'); out.put(++counts[0]); value = static_cast<const resistor*>(top.node)->get_characteristic(); break;
+					case unit_kind::inductor: out.put('L'); out.put(++counts[1]); value = static_cast<const inductor*>(top.node)->get_characteristic(); break;
+					default: out.put('C'); out.put(++counts[2]); value = static_cast<const capacitor*>(top.node)->get_characteristic(); break;
+					}
+					out.put(' '); out.put(value); out.put('\n');
+				}
+				pending.pop_back();
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<unit>> parse_netlist(std::string_view text) { return netlist_parser(text).parse(); }
+
+	std::vector<std::unique_ptr<unit>> load_netlist(const std::string& path)
+	{
+		mapped_file file(path);
+		return parse_netlist(std::string_view(file.data(), file.size()));
+	}
+
+	network parse_network(std::string_view text) { return network_parser(text).parse(); }
+
+	network load_network(const std::string& path)
+	{
+		mapped_file file(path);
+		return parse_network(std::string_view(file.data(), file.size()));
+	}
+
+	void write_netlist(std::ostream& out, const std::vector<std::unique_ptr<unit>>& units)
+	{
+		buffered_writer writer(out);
+		std::size_t counts[3]{ 0, 0, 0 }; // resistors, inductors and capacitors named so far
+		writer.put("* analogue circuit netlist\n");
+		for (const auto& unit_ptr : units) { write_tree(writer, *unit_ptr, counts); }
+		writer.put(".end\n");
+	}
+
+	void write_netlist(std::ostream& out, const unit& root)
+	{
+		buffered_writer writer(out);
+		std::size_t counts[3]{ 0, 0, 0 };
+		writer.put("* analogue circuit netlist\n");
+		write_tree(writer, root, counts);
+		writer.put(".end\n");
+	}
+
+	void write_network(std::ostream& out, const network& circuit)
+	{
+		buffered_writer writer(out);
+		std::size_t counts[3]{ 0, 0, 0 };
+		writer.put("* analogue circuit network\n");
+		for (const network_element& e : circuit.get_elements()) {
+			switch (e.kind) {
+			case unit_kind::resistor: writer.put('R'); writer.put(++counts[0]); break;
+			case unit_kind::inductor: writer.put('L'); writer.put(++counts[1]); break;
+			default: writer.put('C'); writer.put(++counts[2]); break;
+			}
+			writer.put(' '); writer.put(circuit.node_name(e.from)); writer.put(' '); writer.put(circuit.node_name(e.to));
+			writer.put(' '); writer.put(e.value); writer.put('\n');
+		}
+		if (circuit.port_set()) {
+			writer.put(".port "); writer.put(circuit.node_name(circuit.get_port_positive())); writer.put(' ');
+			writer.put(circuit.node_name(circuit.get_port_negative())); writer.put('\n');
+		}
+		writer.put(".end\n");
+	}
+}
@@ -0,0 +1,60 @@
+// header file for reading and writing circuits as text netlists. The format is SPICE-like, one item per line:
+//
+//   * comment (lines starting with '*', '#' or ';' are ignored, as is anything after ';' on a line)
+//   R1 4.7k          resistor in ohms; the name after the letter is free-form and not kept
+//   L1 10u           inductor in henries
+//   C1 100n          capacitor in farads
+//   .series          opens a series group, closed by the matching .ends
+//   .parallel        opens a parallel group, closed by the matching .ends
+//   .ends
+//   .end             optional; anything after it is ignored
+//
+// Values take the SPICE scale suffixes f p n u m k meg g t (any case); letters after the suffix, e.g. "Ohm", are
+// ignored. As in SPICE, a unit written straight after the number is read as a suffix if it is one: "C1 1F" is one
+// femtofarad and "L1 1H" one henry, so write farads as "C1 1" or "C1 1uF". Items outside every group make up the returned list, in order.
+//
+// Networks (see network.h) use the node form instead, which can describe bridges and meshes:
+//
+//   R1 in mid 4.7k   component between two named nodes
+//   C1 mid 0 100n
+//   .port in 0       the two nodes the impedance is seen between; required, and given once
+//   .end
+#pragma once
+#ifndef netlist_h
+#define netlist_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <cstddef>
+#include "unit_class.h"
+#include "network.h"
+
+namespace unit_namespace {
+
+	class netlist_error : public std::runtime_error
+	{
+	private:
+		std::size_t line_number;
+	public:
+		netlist_error(std::size_t line, const std::string& message);
+		std::size_t line() const { return line_number; }
+	};
+
+	std::vector<std::unique_ptr<unit>> parse_netlist(std::string_view text);
+	// tokenizes in place, so no string is allocated per token; throws netlist_error on malformed input
+	std::vector<std::unique_ptr<unit>> load_netlist(const std::string& path); // memory-maps the file and parses it
+
+	void write_netlist(std::ostream& out, const std::vector<std::unique_ptr<unit>>& units);
+	void write_netlist(std::ostream& out, const unit& root);
+	// values are written in shortest round-trip form, so parsing the output rebuilds an identical tree
+
+	network parse_network(std::string_view text); // throws netlist_error on malformed input or a missing .port
+	network load_network(const std::string& path);
+	void write_network(std::ostream& out, const network& circuit);
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "network.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	std::uint32_t network::node(std::string_view name)
+	{
+		auto found = node_numbers.find(std::string(name));
+		if (found != node_numbers.end()) { return found->second; }
+		std::uint32_t number = static_cast<std::uint32_t>(node_names.size());
+		node_names.emplace_back(name);
+		node_numbers.emplace(node_names.back(), number);
+		return number;
+	}
+
+	std::uint32_t network::add_node()
+	{
+		std::uint32_t number = static_cast<std::uint32_t>(node_names.size());
+		node_names.push_back("_" + std::to_string(number)); // not entered in the lookup, so it cannot clash with a named node
+		return number;
+	}
+
+	void network::add(unit_kind kind, std::uint32_t from, std::uint32_t to, double value)
+	{
+		if (kind == unit_kind::series || kind == unit_kind::parallel) { throw std::invalid_argument("network elements must be components"); }
+		if (from >= node_names.size() || to >= node_names.size()) { throw std::invalid_argument("network element refers to an unknown node"); }
+		if (!std::isfinite(value) || value < 0) { throw std::invalid_argument("component values must be finite and not negative"); }
+		elements.push_back({ kind, from, to, value });
+	}
+
+	void network::add(unit_kind kind, std::string_view from, std::string_view to, double value)
+	{
+		std::uint32_t a = node(from), b = node(to);
+		add(kind, a, b, value);
+	}
+
+	void network::set_port(std::uint32_t positive, std::uint32_t negative)
+	{
+		if (positive >= node_names.size() || negative >= node_names.size()) { throw std::invalid_argument("port refers to an unknown node"); }
+		port_positive = positive; port_negative = negative; has_port = true;
+	}
+
+	network to_network(const unit& root)
+	{
+		network result;
+		std::uint32_t in = result.node("in"), out = result.node("out");
+		struct frame { const unit* node; std::uint32_t from, to; std::size_t next_child; std::uint32_t next_from; };
+		std::vector<frame> pending{ { &root, in, out, 0, in } }; // iterative, so deep trees cannot overflow the call stack
+		while (!pending.empty()) {
+			frame& top = pending.back();
+			unit_kind kind = top.node->get_kind();
+			if (kind == unit_kind::series || kind == unit_kind::parallel) {
+				const auto& children = static_cast<const circuit*>(top.node)->get_units();
+				if (top.next_child < children.size()) {
+					const unit* child = children[top.next_child++].get();
+					std::uint32_t from = top.from, to = top.to;
+					if (kind == unit_kind::series) { // chain: from -> internal -> ... -> to
+						from = top.next_from;
+						to = top.next_child == children.size() ? top.to : result.add_node();
+						top.next_from = to;
+					}
+					pending.push_back({ child, from, to, 0, from }); // top is invalidated here
+					continue;
+				}
+				if (children.empty() && kind == unit_kind::series) { result.add(unit_kind::resistor, top.from, top.to, 0); } // evaluates to a short
+			}
+			else {
+				double value{ 0 };
+				switch (kind) {
+				case unit_kind::resistor: value = static_cast<const resistor*>(top.node)->get_characteristic(); break;
+				case unit_kind::inductor: value = static_cast<const inductor*>(top.node)->get_characteristic(); break;
+				default: value = static_cast<const capacitor*>(top.node)->get_characteristic(); break;
+				}
+				result.add(kind, top.from, top.to, value);
+			}
+			pending.pop_back();
+		}
+		result.set_port(in, out);
+		return result;
+	}
+}
@@ -0,0 +1,54 @@
+// header file for node-based circuits. A network is a list of resistors, inductors and capacitors, each connected between
+// two named nodes, plus one port (a pair of nodes) whose impedance is wanted. Unlike the unit tree this can describe any
+// topology, bridges and meshes included; see mna_solver.h for how it is evaluated.
+#pragma once
+#ifndef network_h
+#define network_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "unit_class.h"
+
+namespace unit_namespace {
+
+	struct network_element
+	{
+		unit_kind kind; // resistor, inductor or capacitor
+		std::uint32_t from, to; // node numbers
+		double value; // ohms, henries or farads
+	};
+
+	class network
+	{
+	private:
+		std::vector<std::string> node_names;
+		std::unordered_map<std::string, std::uint32_t> node_numbers;
+		std::vector<network_element> elements;
+		std::uint32_t port_positive{ 0 }, port_negative{ 0 };
+		bool has_port{ false };
+	public:
+		std::uint32_t node(std::string_view name); // number of the named node, adding it if it is new
+		std::uint32_t add_node(); // an unnamed internal node
+		void add(unit_kind kind, std::uint32_t from, std::uint32_t to, double value);
+		void add(unit_kind kind, std::string_view from, std::string_view to, double value);
+		// throws std::invalid_argument for a circuit kind, an unknown node number, or a negative or non-finite value
+		void set_port(std::uint32_t positive, std::uint32_t negative); // the impedance is seen looking in between these two
+
+		std::size_t node_count() const { return node_names.size(); }
+		const std::string& node_name(std::uint32_t number) const { return node_names[number]; }
+		const std::vector<network_element>& get_elements() const { return elements; }
+		bool port_set() const { return has_port; }
+		std::uint32_t get_port_positive() const { return port_positive; }
+		std::uint32_t get_port_negative() const { return port_negative; }
+	};
+
+	network to_network(const unit& root);
+	// the same circuit with explicit nodes: series members are chained through internal nodes and parallel members share
+	// their two end nodes; the port is between nodes "in" and "out"
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "node_pool.h"
+
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace unit_namespace {
+
+	namespace node_pool {
+
+		struct arena_block
+		{
+			std::atomic<std::size_t> live; // nodes still in the block, plus one while its arena_scope is open
+			std::size_t capacity;
+			std::size_t used;
+		};
+
+		namespace {
+			struct node_header // sits just in front of every node so deallocate knows where the memory came from
+			{
+				arena_block* block; // owning arena, or null for pooled and plain heap nodes
+				std::uint32_t size_class; // free list index, or zero for plain heap nodes
+			};
+
+			constexpr std::size_t alignment{ alignof(std::max_align_t) };
+			constexpr std::size_t round_up(std::size_t n) { return (n + alignment - 1) / alignment * alignment; }
+			constexpr std::size_t header_bytes{ round_up(sizeof(node_header)) };
+			constexpr std::size_t block_header_bytes{ round_up(sizeof(arena_block)) };
+			constexpr std::size_t class_count{ 16 }; // classes of alignment-sized steps; bigger nodes use the global heap
+			constexpr std::size_t slab_bytes{ 64 * 1024 };
+
+			std::atomic<bool> pooling_on{ true };
+
+			struct free_node { free_node* next; };
+
+			struct orphan_lists // free lists left behind by threads that have exited, for the next new thread to adopt
+			{
+				std::mutex mutex;
+				std::vector<free_node*> heads[class_count + 1];
+			};
+			orphan_lists& orphans() { static orphan_lists lists; return lists; }
+
+			struct thread_cache
+			{
+				free_node* heads[class_count + 1]{}; // index 0 unused
+				char* slab_next{ nullptr };
+				char* slab_end{ nullptr };
+				arena_block* arena{ nullptr }; // block of the innermost open arena_scope
+
+				thread_cache()
+				{
+					orphan_lists& o = orphans();
+					std::lock_guard<std::mutex> lock(o.mutex);
+					for (std::size_t c = 1; c <= class_count; c++) {
+						if (!o.heads[c].empty()) { heads[c] = o.heads[c].back(); o.heads[c].pop_back(); }
+					}
+				}
+				~thread_cache() // slabs are never returned to the system, but their free nodes stay reusable
+				{
+					orphan_lists& o = orphans();
+					std::lock_guard<std::mutex> lock(o.mutex);
+					for (std::size_t c = 1; c <= class_count; c++) {
+						if (heads[c]) { o.heads[c].push_back(heads[c]); }
+					}
+				}
+			};
+			thread_local thread_cache cache;
+
+			void* carve_from_slab(thread_cache& local, std::size_t bytes)
+			{
+				if (local.slab_next == nullptr || local.slab_end - local.slab_next < static_cast<std::ptrdiff_t>(bytes)) {
+					local.slab_next = static_cast<char*>(::operator new(slab_bytes)); // tail of the old slab is abandoned
+					local.slab_end = local.slab_next + slab_bytes;
+				}
+				void* p = local.slab_next;
+				local.slab_next += bytes;
+				return p;
+			}
+
+			void release(arena_block* block)
+			{
+				if (block->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					block->~arena_block();
+					::operator delete(static_cast<void*>(block));
+				}
+			}
+		}
+
+		std::size_t node_bytes(std::size_t object_size) { return header_bytes + round_up(object_size); }
+
+		void set_pooling(bool on) { pooling_on = on; }
+		bool pooling() { return pooling_on; }
+		bool in_arena() { return cache.arena != nullptr; }
+
+		void* allocate(std::size_t size)
+		{
+			std::size_t bytes = node_bytes(size);
+			node_header header{ nullptr, 0 };
+			void* raw{ nullptr };
+			thread_cache& local = cache; // one thread_local lookup per call
+
+			arena_block* arena = local.arena;
+			if (arena != nullptr && arena->capacity - arena->used >= bytes) {
+				raw = reinterpret_cast<char*>(arena) + block_header_bytes + arena->used;
+				arena->used += bytes;
+				arena->live.fetch_add(1, std::memory_order_relaxed);
+				header.block = arena;
+			}
+			else if (pooling_on.load(std::memory_order_relaxed) && bytes / alignment <= class_count) {
+				header.size_class = static_cast<std::uint32_t>(bytes / alignment);
+				free_node*& head = local.heads[header.size_class];
+				if (head != nullptr) { raw = head; head = head->next; }
+				else { raw = carve_from_slab(local, bytes); }
+			}
+			else { raw = ::operator new(bytes); }
+
+			new (raw) node_header(header);
+			return static_cast<char*>(raw) + header_bytes;
+		}
+
+		void deallocate(void* p) noexcept
+		{
+			if (p == nullptr) { return; }
+			void* raw = static_cast<char*>(p) - header_bytes;
+			node_header header = *static_cast<node_header*>(raw);
+			if (header.block != nullptr) { release(header.block); }
+			else if (header.size_class != 0) {
+				free_node* node = static_cast<free_node*>(raw);
+				thread_cache& local = cache;
+				node->next = local.heads[header.size_class]; // freed nodes join the freeing thread's list
+				local.heads[header.size_class] = node;
+			}
+			else { ::operator delete(raw); }
+		}
+
+		arena_scope::arena_scope(std::size_t bytes)
+		{
+			if (cache.arena != nullptr || bytes == 0 || !pooling_on.load(std::memory_order_relaxed)) { return; }
+			void* raw = ::operator new(block_header_bytes + bytes);
+			block = new (raw) arena_block{};
+			block->live.store(1, std::memory_order_relaxed);
+			block->capacity = bytes; block->used = 0;
+			cache.arena = block;
+		}
+
+		arena_scope::~arena_scope()
+		{
+			if (block == nullptr) { return; }
+			cache.arena = nullptr;
+			release(block);
+		}
+	}
+}
@@ -0,0 +1,50 @@
+// header file for the allocator behind unit's operator new. Nodes normally come from thread-local free lists of fixed
+// size classes carved out of large slabs; while an arena_scope is open (e.g. during clone) they are instead carved one
+// after another out of a single block that is released once every node in it has been deleted. node_pool::allocator
+// puts a container's buffer in the pool the same way, so a circuit's list of children can share its clone's block.
+#pragma once
+#ifndef node_pool_h
+#define node_pool_h
+
+#include <cstddef>
+
+namespace unit_namespace {
+
+	namespace node_pool {
+
+		struct arena_block; // defined in node_pool.cpp
+
+		void* allocate(std::size_t size);
+		void deallocate(void* p) noexcept;
+		std::size_t node_bytes(std::size_t object_size); // space a node of this size takes in an arena, header included
+
+		void set_pooling(bool on); // off sends every node straight to the global heap; for comparisons in benchmarks
+		bool pooling();
+		bool in_arena(); // true while an arena_scope is open on this thread
+
+		class arena_scope // while alive, nodes allocated on this thread come from one block of the requested size
+		{
+		private:
+			arena_block* block{ nullptr }; // stays null if an outer scope was already open, which then keeps serving nodes
+		public:
+			explicit arena_scope(std::size_t bytes);
+			~arena_scope();
+			arena_scope(const arena_scope&) = delete;
+			arena_scope& operator=(const arena_scope&) = delete;
+		};
+
+		template<typename T>
+		struct allocator // for std containers; a buffer of n elements takes node_bytes(n * sizeof(T)) in an arena
+		{
+			using value_type = T;
+			allocator() = default;
+			template<typename U> allocator(const allocator<U>&) noexcept {}
+			T* allocate(std::size_t n) { return static_cast<T*>(node_pool::allocate(n * sizeof(T))); }
+			void deallocate(T* p, std::size_t) noexcept { node_pool::deallocate(p); }
+			template<typename U> bool operator==(const allocator<U>&) const noexcept { return true; } // any one frees another's
+			template<typename U> bool operator!=(const allocator<U>&) const noexcept { return false; }
+		};
+	}
+}
+
+#endif
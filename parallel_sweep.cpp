@@ -0,0 +1,43 @@
+#include "parallel_sweep.h"
+#include "sweep.h"
+
+namespace unit_namespace {
+
+	std::vector<std::complex<double>> parallel_sweep(const flat_view& circuit, const std::vector<double>& omegas,
+		thread_pool& pool, const sweep_options& options)
+	{
+		UNIT_TIME(sweep, "parallel_sweep");
+		std::vector<std::complex<double>> result(omegas.size());
+		pool.parallel_for(omegas.size(), options.chunk, [&](std::size_t begin, std::size_t end) {
+			if (options.vectorized) {
+				std::vector<double> real(end - begin), imag(end - begin);
+				sweep_impedance(circuit, omegas.data() + begin, end - begin, real.data(), imag.data());
+				for (std::size_t k = begin; k < end; k++) { result[k] = std::complex<double>{ real[k - begin], imag[k - begin] }; }
+			}
+			else {
+				std::vector<std::complex<double>> stack(circuit.max_stack); // one scratch stack per chunk, not per point
+				for (std::size_t k = begin; k < end; k++) { result[k] = circuit.get_impedance(eval_context{ omegas[k] }, stack.data()); }
+			}
+		});
+		return result;
+	}
+
+	std::vector<std::complex<double>> parallel_sweep(const unit& root, const std::vector<double>& omegas,
+		const sweep_options& options)
+	{
+		UNIT_TIME(sweep, "parallel_sweep");
+		flat_circuit flat(root);
+		thread_pool pool(options.threads);
+		return parallel_sweep(flat.view(), omegas, pool, options);
+	}
+
+	std::vector<std::complex<double>> parallel_impedance(const std::vector<std::unique_ptr<unit>>& units,
+		const eval_context& context, thread_pool& pool, std::size_t chunk)
+	{
+		std::vector<std::complex<double>> result(units.size());
+		pool.parallel_for(units.size(), chunk, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t k = begin; k < end; k++) { result[k] = units[k]->get_impedance(context); }
+		});
+		return result;
+	}
+}
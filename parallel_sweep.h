@@ -0,0 +1,35 @@
+// header file for the parallel sweep engine. Frequency points, or independent circuits from a list, are split into
+// chunks and spread over a work-stealing thread pool.
+#pragma once
+#ifndef parallel_sweep_h
+#define parallel_sweep_h
+
+#include <complex>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+#include "thread_pool.h"
+
+namespace unit_namespace {
+
+	struct sweep_options
+	{
+		std::size_t threads{ 0 }; // zero means one per hardware core; only used by the overloads that make their own pool
+		std::size_t chunk{ 4096 }; // frequency points (or circuits) per task
+		bool vectorized{ false }; // use the batched SIMD kernels; faster, but only equal to get_impedance to rounding
+	};
+
+	std::vector<std::complex<double>> parallel_sweep(const flat_view& circuit, const std::vector<double>& omegas,
+		thread_pool& pool, const sweep_options& options = {});
+	std::vector<std::complex<double>> parallel_sweep(const unit& root, const std::vector<double>& omegas,
+		const sweep_options& options = {});
+	// with vectorized off every point is bit-for-bit what root.get_impedance(eval_context{ omega }) gives
+
+	std::vector<std::complex<double>> parallel_impedance(const std::vector<std::unique_ptr<unit>>& units,
+		const eval_context& context, thread_pool& pool, std::size_t chunk = 1);
+	// impedance of every unit in a list, e.g. the master list, with the circuits shared out between threads
+}
+
+#endif
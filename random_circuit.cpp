@@ -0,0 +1,109 @@
+#include "random_circuit.h"
+#include "counter_rng.h"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	namespace {
+		constexpr std::size_t parallel_threshold{ 16384 }; // subtrees smaller than this are built by one thread
+		constexpr std::size_t unlimited{ std::numeric_limits<std::size_t>::max() };
+
+		struct child_plan { std::uint64_t id; std::size_t size; };
+
+		class generator
+		{
+		private:
+			const random_circuit_options& options;
+			thread_pool* pool;
+			std::vector<std::size_t> capacity; // capacity[r] is the most units a tree of r levels can hold
+
+			std::size_t capacity_at(std::size_t levels) const { return levels < capacity.size() ? capacity[levels] : unlimited; }
+
+		public:
+			generator(const random_circuit_options& settings, thread_pool* workers) : options{ settings }, pool{ workers }
+			{
+				if (options.size == 0) { throw std::invalid_argument("random_circuit: size must be at least one"); }
+				if (options.min_fanout == 0 || options.min_fanout > options.max_fanout || options.max_fanout < 2) {
+					throw std::invalid_argument("random_circuit: need 1 <= min_fanout <= max_fanout and max_fanout >= 2");
+				}
+				if (!(options.max_value > 0)) { throw std::invalid_argument("random_circuit: max_value must be positive"); }
+				capacity.push_back(0);
+				while (capacity.size() <= options.max_depth && capacity.back() != unlimited) { // 1 + F*cap(r-1), saturating
+					std::size_t below = capacity.back();
+					capacity.push_back(below > (unlimited - 1) / options.max_fanout ? unlimited : 1 + options.max_fanout * below);
+				}
+				if (options.size > capacity_at(options.max_depth == 0 ? unlimited : options.max_depth)) {
+					throw std::invalid_argument("random_circuit: size does not fit within max_depth and max_fanout");
+				}
+			}
+
+			std::unique_ptr<unit> build(std::uint64_t id, std::size_t size, std::size_t levels) const
+			// id is the preorder number of this unit in the whole tree; levels may be unlimited
+			{
+				counter_stream random(options.seed, id);
+				if (size == 1) {
+					std::uint64_t kind = random.next_below(3);
+					double value = options.max_value * (1 - random.next_double()); // (0, max_value]
+					if (kind == 0) { return std::make_unique<inductor>(value / 1000000); } // same scaling as random_list_generator
+					if (kind == 1) { return std::make_unique<resistor>(value); }
+					return std::make_unique<capacitor>(value / 1000000.);
+				}
+
+				bool parallel = random.next_below(2) == 1;
+				std::size_t budget = size - 1, below = capacity_at(levels == unlimited ? unlimited : levels - 1);
+				std::size_t fanout = options.min_fanout + random.next_below(options.max_fanout - options.min_fanout + 1);
+				std::size_t fewest = below == unlimited ? 1 : (budget + below - 1) / below; // children needed to hold the budget
+				fanout = std::max(std::min(fanout, budget), fewest);
+
+				// split the budget into child sizes near an even share, jittered by up to half a share either way
+				std::vector<child_plan> plans(fanout);
+				std::uint64_t next_id = id + 1;
+				for (std::size_t i = 0; i < fanout; i++) {
+					std::size_t left = fanout - i - 1; // siblings still to come, each needing between 1 and below units
+					std::size_t lowest = left == 0 ? budget : below >= (budget + left - 1) / left ? 1 : budget - left * below;
+					std::size_t highest = std::min(below, budget - left);
+					double share = static_cast<double>(budget) / (left + 1);
+					std::size_t pick = static_cast<std::size_t>(share * (0.5 + random.next_double()));
+					plans[i] = { next_id, std::clamp(pick, lowest, highest) };
+					next_id += plans[i].size;
+					budget -= plans[i].size;
+				}
+
+				std::vector<std::unique_ptr<unit>> children(fanout);
+				std::size_t next_levels = levels == unlimited ? unlimited : levels - 1;
+				if (pool != nullptr && size >= parallel_threshold) {
+					pool->parallel_for(fanout, 1, [&](std::size_t begin, std::size_t end) {
+						for (std::size_t i = begin; i < end; i++) { children[i] = build(plans[i].id, plans[i].size, next_levels); }
+					});
+				}
+				else {
+					for (std::size_t i = 0; i < fanout; i++) { children[i] = build(plans[i].id, plans[i].size, next_levels); }
+				}
+				if (parallel) { return std::make_unique<parallel_circuit>(std::move(children)); }
+				return std::make_unique<series_circuit>(std::move(children));
+			}
+		};
+
+		std::unique_ptr<unit> generate(const random_circuit_options& options, thread_pool* pool)
+		{
+			generator maker(options, pool);
+			return maker.build(0, options.size, options.max_depth == 0 ? unlimited : options.max_depth);
+		}
+	}
+
+	std::unique_ptr<unit> random_circuit(const random_circuit_options& options, thread_pool& pool)
+	{
+		return generate(options, &pool);
+	}
+
+	std::unique_ptr<unit> random_circuit(const random_circuit_options& options)
+	{
+		if (options.threads == 1 || options.size < parallel_threshold) { return generate(options, nullptr); }
+		thread_pool pool(options.threads);
+		return generate(options, &pool);
+	}
+}
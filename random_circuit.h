@@ -0,0 +1,33 @@
+// header file for the seeded random circuit generator used for load testing. It builds nested series and parallel trees
+// of a chosen size, depth and fan-out. Every random draw is keyed by (seed, node number) through a counter-based
+// generator, so subtrees can be built on different threads and a given seed always gives the same tree, whatever the
+// thread count.
+#pragma once
+#ifndef random_circuit_h
+#define random_circuit_h
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "unit_class.h"
+#include "thread_pool.h"
+
+namespace unit_namespace {
+
+	struct random_circuit_options
+	{
+		std::uint64_t seed{ 0 };
+		std::size_t size{ 1000 }; // exact number of units in the tree, circuits included
+		std::size_t max_depth{ 0 }; // levels including the root, so 1 means a single component; zero means no limit
+		std::size_t min_fanout{ 2 }; // sub-units per circuit, drawn uniformly between these two; a circuit with less
+		std::size_t max_fanout{ 8 }; // remaining budget than min_fanout gets as many as the budget allows
+		double max_value{ 10 }; // characteristics are drawn from (0, max_value], inductors and capacitors then scaled by 1e-6
+		std::size_t threads{ 0 }; // zero means one per hardware core; only used by the overload that makes its own pool
+	};
+
+	std::unique_ptr<unit> random_circuit(const random_circuit_options& options, thread_pool& pool);
+	std::unique_ptr<unit> random_circuit(const random_circuit_options& options);
+	// throws std::invalid_argument if the options are inconsistent or size cannot fit within max_depth and max_fanout
+}
+
+#endif
@@ -0,0 +1,227 @@
+#include "rational_impedance.h"
+#include "sweep.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	namespace {
+		using polynomial = std::vector<double>; // ascending powers of the scaled variable
+
+		struct rational { polynomial numerator, denominator; };
+
+		polynomial multiply(const polynomial& a, const polynomial& b)
+		{
+			polynomial product(a.size() + b.size() - 1, 0.);
+			for (std::size_t i = 0; i < a.size(); i++) {
+				for (std::size_t j = 0; j < b.size(); j++) { product[i + j] += a[i] * b[j]; }
+			}
+			return product;
+		}
+
+		polynomial add(polynomial a, const polynomial& b)
+		{
+			if (a.size() < b.size()) { a.resize(b.size(), 0.); }
+			for (std::size_t i = 0; i < b.size(); i++) { a[i] += b[i]; }
+			return a;
+		}
+
+		rational add(const rational& a, const rational& b) // a.n/a.d + b.n/b.d
+		{
+			return { add(multiply(a.numerator, b.denominator), multiply(b.numerator, a.denominator)), multiply(a.denominator, b.denominator) };
+		}
+
+		rational reciprocal(rational r) { std::swap(r.numerator, r.denominator); return r; }
+
+		bool is_zero(const polynomial& p) { return std::all_of(p.begin(), p.end(), [](double c) { return c == 0; }); }
+
+		std::size_t degree(const polynomial& p) { return p.empty() ? 0 : p.size() - 1; }
+
+		void tidy(rational& r) // drops exact zeros at the top, cancels common powers of s and rescales
+		{
+			for (polynomial* p : { &r.numerator, &r.denominator }) {
+				while (p->size() > 1 && p->back() == 0) { p->pop_back(); }
+			}
+			std::size_t shift{ 0 };
+			while (shift + 1 < r.numerator.size() && shift + 1 < r.denominator.size() && r.numerator[shift] == 0 && r.denominator[shift] == 0) { shift++; }
+			r.numerator.erase(r.numerator.begin(), r.numerator.begin() + shift);
+			r.denominator.erase(r.denominator.begin(), r.denominator.begin() + shift);
+			double largest{ 0 };
+			for (double c : r.denominator) { largest = std::max(largest, std::abs(c)); }
+			if (largest == 0 || !std::isfinite(largest)) { return; }
+			for (polynomial* p : { &r.numerator, &r.denominator }) {
+				for (double& c : *p) { c /= largest; }
+			}
+		}
+
+		void split(const polynomial& p, polynomial& even, polynomial& odd) // p(s) = even(s^2) + s odd(s^2)
+		{
+			even.clear(); odd.clear();
+			for (std::size_t i = 0; i < p.size(); i++) { (i % 2 == 0 ? even : odd).push_back(p[i]); }
+		}
+
+		void horner(const polynomial& p, const double* x, std::size_t n, double* out) // one coefficient at a time over the block
+		{
+			if (p.empty()) { std::fill(out, out + n, 0.); return; }
+			std::fill(out, out + n, p.back());
+			for (std::size_t i = p.size() - 1; i-- > 0;) {
+				double c = p[i];
+				for (std::size_t k = 0; k < n; k++) { out[k] = out[k] * x[k] + c; }
+			}
+		}
+
+		double relative_error(std::complex<double> value, std::complex<double> reference)
+		{
+			if (value == reference) { return 0; }
+			double error = std::abs(value - reference), size = std::abs(reference);
+			if (!std::isfinite(error)) { return std::numeric_limits<double>::infinity(); }
+			return size == 0 ? error : error / size;
+		}
+	}
+
+	rational_impedance::rational_impedance(const unit& root, double omega_min, double omega_max, const rational_options& options)
+		: tree(root)
+	{
+		if (!(omega_min > 0) || !(omega_max >= omega_min) || !std::isfinite(omega_max)) {
+			throw std::invalid_argument("rational_impedance: need 0 < omega_min <= omega_max");
+		}
+		omega_scale = std::sqrt(omega_min) * std::sqrt(omega_max); // geometric centre of the range
+		if (!compile(options)) { return; }
+
+		std::size_t points = std::max<std::size_t>(options.check_points, omega_min == omega_max ? 1 : 2);
+		std::vector<double> omegas(points);
+		for (std::size_t k = 0; k < points; k++) {
+			omegas[k] = points == 1 ? omega_min : omega_min * std::pow(omega_max / omega_min, static_cast<double>(k) / (points - 1));
+		}
+		omegas.back() = omega_max; // pow does not land on it exactly
+		rational_report checked = check(omegas);
+		report.points_checked = checked.points_checked;
+		report.max_relative_error = checked.max_relative_error;
+		report.worst_omega = checked.worst_omega;
+		if (!(checked.max_relative_error <= options.tolerance)) {
+			report.compiled = false;
+			report.reason = "relative error above tolerance";
+		}
+	}
+
+	bool rational_impedance::compile(const rational_options& options)
+	{
+		flat_view view = tree.view();
+		std::vector<rational> stack;
+		stack.reserve(view.max_stack);
+		for (std::size_t i = 0; i < view.size; i++) {
+			double value = view.characteristics[i];
+			switch (static_cast<unit_kind>(view.kinds[i])) {
+			case unit_kind::resistor: stack.push_back({ { value }, { 1. } }); break;
+			case unit_kind::inductor: stack.push_back({ { 0., value * omega_scale }, { 1. } }); break; // L s = (L scale)(s/scale)
+			case unit_kind::capacitor: stack.push_back({ { 1. }, { 0., value * omega_scale } }); break;
+			case unit_kind::series:
+			case unit_kind::parallel: {
+				bool parallel = view.kinds[i] == static_cast<std::uint8_t>(unit_kind::parallel);
+				std::size_t first = stack.size() - view.arities[i];
+				if (first == stack.size()) { // no members: zero impedance in series, infinite in parallel, as the tree gives
+					stack.push_back(parallel ? rational{ { 1. }, { 0. } } : rational{ { 0. }, { 1. } });
+					break; // and so left to the tree evaluator, like a zero-valued component
+				}
+				rational sum = parallel ? reciprocal(std::move(stack[first])) : std::move(stack[first]); // admittances add in parallel
+				for (std::size_t j = first + 1; j < stack.size(); j++) {
+					sum = add(sum, parallel ? reciprocal(std::move(stack[j])) : std::move(stack[j]));
+					tidy(sum);
+					if (std::max(degree(sum.numerator), degree(sum.denominator)) > options.max_degree) {
+						report.reason = "degree above max_degree";
+						return false;
+					}
+				}
+				stack.resize(first);
+				stack.push_back(parallel ? reciprocal(std::move(sum)) : std::move(sum));
+				break;
+			}
+			}
+			rational& top = stack.back();
+			tidy(top);
+			if (is_zero(top.numerator) || is_zero(top.denominator)) {
+				report.reason = "zero or infinite impedance in the tree"; // e.g. a zero-valued component; left to the tree evaluator
+				return false;
+			}
+			for (const polynomial* p : { &top.numerator, &top.denominator }) {
+				if (!std::all_of(p->begin(), p->end(), [](double c) { return std::isfinite(c); })) {
+					report.reason = "coefficients out of range";
+					return false;
+				}
+			}
+		}
+		if (stack.size() != 1) { report.reason = "empty circuit"; return false; }
+
+		numerator = std::move(stack.back().numerator);
+		denominator = std::move(stack.back().denominator);
+		split(numerator, numerator_even, numerator_odd);
+		split(denominator, denominator_even, denominator_odd);
+		report.compiled = true;
+		report.degree = std::max(degree(numerator), degree(denominator));
+		return true;
+	}
+
+	void rational_impedance::evaluate(const double* omegas, std::size_t count, double* real, double* imag) const
+	{
+		double x[sweep_block], ratio[sweep_block], a[sweep_block], b[sweep_block], c[sweep_block], d[sweep_block];
+		for (std::size_t start = 0; start < count; start += sweep_block) {
+			std::size_t n = std::min(sweep_block, count - start);
+			for (std::size_t k = 0; k < n; k++) { ratio[k] = omegas[start + k] / omega_scale; x[k] = -ratio[k] * ratio[k]; } // (j ratio)^2
+			horner(numerator_even, x, n, a); horner(numerator_odd, x, n, b);
+			horner(denominator_even, x, n, c); horner(denominator_odd, x, n, d);
+			for (std::size_t k = 0; k < n; k++) { // (a + jb)/(c + jd), with b and d still to be multiplied by ratio
+				double nb = b[k] * ratio[k], dd = d[k] * ratio[k], size = c[k] * c[k] + dd * dd;
+				real[start + k] = (a[k] * c[k] + nb * dd) / size;
+				imag[start + k] = (nb * c[k] - a[k] * dd) / size;
+			}
+		}
+	}
+
+	rational_report rational_impedance::check(const std::vector<double>& omegas) const
+	{
+		rational_report result = report;
+		result.points_checked = 0; result.max_relative_error = 0; result.worst_omega = 0;
+		if (numerator.empty()) { return result; } // compilation failed, so there is no rational form to compare
+		std::vector<double> real(omegas.size()), imag(omegas.size());
+		evaluate(omegas.data(), omegas.size(), real.data(), imag.data());
+		flat_view view = tree.view();
+		std::vector<std::complex<double>> stack(view.max_stack);
+		for (std::size_t k = 0; k < omegas.size(); k++) {
+			double error = relative_error({ real[k], imag[k] }, view.get_impedance(eval_context{ omegas[k] }, stack.data()));
+			if (!(error <= result.max_relative_error)) { result.max_relative_error = error; result.worst_omega = omegas[k]; }
+		}
+		result.points_checked = omegas.size();
+		return result;
+	}
+
+	std::complex<double> rational_impedance::get_impedance(const eval_context& context) const
+	{
+		if (!report.compiled) { return tree.get_impedance(context); }
+		double real, imag;
+		evaluate(&context.omega, 1, &real, &imag);
+		return { real, imag };
+	}
+
+	void rational_impedance::sweep(const double* omegas, std::size_t count, double* real, double* imag) const
+	{
+		if (report.compiled) { evaluate(omegas, count, real, imag); return; }
+		flat_view view = tree.view();
+		std::vector<std::complex<double>> stack(view.max_stack);
+		for (std::size_t k = 0; k < count; k++) {
+			std::complex<double> z = view.get_impedance(eval_context{ omegas[k] }, stack.data());
+			real[k] = z.real(); imag[k] = z.imag();
+		}
+	}
+
+	std::vector<std::complex<double>> rational_impedance::sweep(const std::vector<double>& omegas) const
+	{
+		std::vector<double> real(omegas.size()), imag(omegas.size());
+		sweep(omegas.data(), omegas.size(), real.data(), imag.data());
+		std::vector<std::complex<double>> result(omegas.size());
+		for (std::size_t k = 0; k < omegas.size(); k++) { result[k] = { real[k], imag[k] }; }
+		return result;
+	}
+}
@@ -0,0 +1,69 @@
+// header file for compiling a unit tree into its impedance as a rational function of s = j*omega. Resistors, inductors
+// and capacitors are R, Ls and 1/(Cs), and series and parallel combinations of rational functions are rational, so the
+// whole tree collapses to N(s)/D(s) with real coefficients. Each frequency then costs a few Horner evaluations instead
+// of a complex division per parallel circuit.
+//
+// Common factors other than powers of s are not cancelled, so the degree grows with the number of reactive components
+// and the polynomials can become badly conditioned. Compilation is therefore checked against the tree evaluator over
+// the frequency range it will be used for, and falls back to evaluating the tree if the degree or the error is too high.
+#pragma once
+#ifndef rational_impedance_h
+#define rational_impedance_h
+
+#include <complex>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	struct rational_options
+	{
+		std::size_t max_degree{ 32 }; // larger numerators or denominators are not attempted
+		double tolerance{ 1e-9 }; // largest relative error accepted at the check points
+		std::size_t check_points{ 64 }; // log-spaced frequencies, end points included, compared with the tree evaluator
+	};
+
+	struct rational_report
+	{
+		bool compiled{ false }; // false means evaluation falls back to the tree
+		std::string reason; // why it fell back; empty when compiled
+		std::size_t degree{ 0 }; // highest power of s in numerator or denominator
+		std::size_t points_checked{ 0 };
+		double max_relative_error{ 0 }; // against the tree evaluator, over the check points
+		double worst_omega{ 0 }; // where that error occurred
+	};
+
+	class rational_impedance
+	{
+	private:
+		flat_circuit tree; // the fallback, and the reference the rational form is checked against
+		double omega_scale{ 1 }; // coefficients are in powers of s/omega_scale, which keeps them in range
+		std::vector<double> numerator, denominator; // ascending powers
+		std::vector<double> numerator_even, numerator_odd, denominator_even, denominator_odd; // split for Horner in -(omega/scale)^2
+		rational_report report;
+
+		bool compile(const rational_options& options); // fills the coefficients; false, with report.reason set, on failure
+		void evaluate(const double* omegas, std::size_t count, double* real, double* imag) const; // rational form only
+	public:
+		rational_impedance(const unit& root, double omega_min, double omega_max, const rational_options& options = {});
+		// omega_min and omega_max bound the frequencies to be evaluated, in rad/s; throws std::invalid_argument unless
+		// 0 < omega_min <= omega_max. Accuracy outside that range is not checked.
+
+		bool is_rational() const { return report.compiled; }
+		const rational_report& accuracy() const { return report; }
+		rational_report check(const std::vector<double>& omegas) const; // error of the rational form at any frequencies
+
+		double scale() const { return omega_scale; }
+		const std::vector<double>& get_numerator() const { return numerator; } // empty if not compiled
+		const std::vector<double>& get_denominator() const { return denominator; }
+
+		std::complex<double> get_impedance(const eval_context& context) const;
+		void sweep(const double* omegas, std::size_t count, double* real, double* imag) const;
+		std::vector<std::complex<double>> sweep(const std::vector<double>& omegas) const;
+	};
+}
+
+#endif
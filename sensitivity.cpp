@@ -0,0 +1,288 @@
+#include "sensitivity.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+namespace unit_namespace {
+
+	namespace {
+		struct adjoint_workspace // what one forward and backward pass needs; the topology part is worked out once
+		{
+			std::vector<std::uint32_t> parent; // of each node; the root has none
+			std::vector<std::uint32_t> components;
+			std::vector<std::uint32_t> zero_children; // parallel nodes only: members with Z = 0, which short the others out
+			std::vector<std::complex<double>> values, adjoints; // Z of every node, and dZ_root / dZ_node
+			std::vector<std::uint32_t> stack;
+
+			explicit adjoint_workspace(const flat_view& circuit)
+				: parent(circuit.size), zero_children(circuit.size), values(circuit.size), adjoints(circuit.size)
+			{
+				stack.reserve(circuit.max_stack);
+				for (std::uint32_t i = 0; i < circuit.size; i++) {
+					std::size_t arity = circuit.arities[i];
+					unit_kind kind = static_cast<unit_kind>(circuit.kinds[i]);
+					if (kind != unit_kind::series && kind != unit_kind::parallel) { components.push_back(i); }
+					for (std::size_t j = stack.size() - arity; j < stack.size(); j++) { parent[stack[j]] = i; }
+					stack.resize(stack.size() - arity);
+					stack.push_back(i);
+				}
+			}
+		};
+
+		std::complex<double> forward_backward(const flat_view& circuit, double omega, adjoint_workspace& space, std::complex<double>* derivatives)
+		// fills derivatives (one per component) and returns the impedance; the forward pass repeats the arithmetic of
+		// flat_view::get_impedance, so the impedance is the same to the last bit
+		{
+			if (circuit.size == 0) { return {}; }
+			std::vector<std::uint32_t>& stack = space.stack;
+			std::complex<double>* z = space.values.data();
+			stack.clear();
+			for (std::uint32_t i = 0; i < circuit.size; i++) {
+				double c = circuit.characteristics[i];
+				std::size_t first = stack.size() - circuit.arities[i];
+				switch (static_cast<unit_kind>(circuit.kinds[i])) {
+				case unit_kind::resistor: z[i] = std::complex<double>{ c, 0 }; break;
+				case unit_kind::inductor: z[i] = std::complex<double>{ 0, c * omega }; break;
+				case unit_kind::capacitor: z[i] = std::complex<double>{ 0, -1. / (c * omega) }; break;
+				case unit_kind::series: {
+					std::complex<double> sum;
+					for (std::size_t j = first; j < stack.size(); j++) { sum += z[stack[j]]; }
+					z[i] = sum;
+					break;
+				}
+				case unit_kind::parallel: {
+					std::complex<double> sum;
+					std::uint32_t zeros{ 0 };
+					for (std::size_t j = first; j < stack.size(); j++) {
+						sum += 1. / z[stack[j]];
+						if (z[stack[j]] == std::complex<double>{}) { zeros++; }
+					}
+					z[i] = 1. / sum;
+					space.zero_children[i] = zeros;
+					break;
+				}
+				}
+				stack.resize(first);
+				stack.push_back(i);
+			}
+
+			std::complex<double>* adjoint = space.adjoints.data();
+			std::size_t root = circuit.size - 1;
+			adjoint[root] = 1;
+			for (std::size_t i = root; i-- > 0;) { // parents come after their children in postorder
+				std::uint32_t p = space.parent[i];
+				if (static_cast<unit_kind>(circuit.kinds[p]) == unit_kind::series) { adjoint[i] = adjoint[p]; continue; }
+				std::complex<double> local; // dZ_p / dZ_i for Z_p = 1 / sum(1 / Z_k)
+				if (z[i] == std::complex<double>{}) { local = space.zero_children[p] == 1 ? 1 : 0; } // the only short carries everything
+				else if (space.zero_children[p] == 0) { std::complex<double> ratio = z[p] / z[i]; local = ratio * ratio; }
+				adjoint[i] = adjoint[p] * local;
+			}
+
+			for (std::size_t k = 0; k < space.components.size(); k++) {
+				std::uint32_t i = space.components[k];
+				double c = circuit.characteristics[i];
+				std::complex<double> slope; // dZ_i / dc
+				switch (static_cast<unit_kind>(circuit.kinds[i])) {
+				case unit_kind::resistor: slope = { 1, 0 }; break;
+				case unit_kind::inductor: slope = { 0, omega }; break;
+				default: slope = { 0, 1. / (omega * c * c) }; break; // d/dc of -j/(wc)
+				}
+				derivatives[k] = adjoint[i] * slope;
+			}
+			return z[root];
+		}
+
+		bool cholesky_solve(std::vector<double>& matrix, std::size_t n, const std::vector<double>& right, std::vector<double>& solution)
+		// solves matrix * solution = right for a symmetric matrix of which only the lower triangle is filled in, factoring
+		// it in place; false if it is not positive definite
+		{
+			for (std::size_t j = 0; j < n; j++) {
+				double pivot = matrix[j * n + j];
+				for (std::size_t k = 0; k < j; k++) { pivot -= matrix[j * n + k] * matrix[j * n + k]; }
+				if (!(pivot > 0)) { return false; }
+				pivot = std::sqrt(pivot);
+				matrix[j * n + j] = pivot;
+				for (std::size_t i = j + 1; i < n; i++) {
+					double sum = matrix[i * n + j];
+					for (std::size_t k = 0; k < j; k++) { sum -= matrix[i * n + k] * matrix[j * n + k]; }
+					matrix[i * n + j] = sum / pivot;
+				}
+			}
+			for (std::size_t i = 0; i < n; i++) { // L y = right
+				double sum = right[i];
+				for (std::size_t k = 0; k < i; k++) { sum -= matrix[i * n + k] * solution[k]; }
+				solution[i] = sum / matrix[i * n + i];
+			}
+			for (std::size_t i = n; i-- > 0;) { // L^T solution = y
+				double sum = solution[i];
+				for (std::size_t k = i + 1; k < n; k++) { sum -= matrix[k * n + i] * solution[k]; }
+				solution[i] = sum / matrix[i * n + i];
+			}
+			return true;
+		}
+
+		void set_value(unit& component, double value)
+		{
+			switch (component.get_kind()) {
+			case unit_kind::resistor: static_cast<resistor&>(component).set_characteristic(value); break;
+			case unit_kind::inductor: static_cast<inductor&>(component).set_characteristic(value); break;
+			default: static_cast<capacitor&>(component).set_characteristic(value); break;
+			}
+		}
+	}
+
+	impedance_gradient impedance_sensitivities(const flat_view& circuit, const eval_context& context)
+	{
+		adjoint_workspace space(circuit);
+		impedance_gradient result;
+		result.derivatives.resize(space.components.size());
+		result.impedance = forward_backward(circuit, context.omega, space, result.derivatives.data());
+		result.components = std::move(space.components);
+		return result;
+	}
+
+	impedance_gradient impedance_sensitivities(const unit& root, const eval_context& context)
+	{
+		flat_circuit flat(root);
+		return impedance_sensitivities(flat.view(), context);
+	}
+
+	std::vector<unit*> component_list(unit& root)
+	{
+		std::vector<unit*> result;
+		std::vector<unit*> pending{ &root }; // iterative, so deep trees cannot overflow the call stack
+		while (!pending.empty()) {
+			unit* node = pending.back();
+			pending.pop_back();
+			if (node->get_kind() == unit_kind::series || node->get_kind() == unit_kind::parallel) {
+				const auto& children = static_cast<circuit*>(node)->get_units();
+				for (auto child = children.rbegin(); child != children.rend(); ++child) { pending.push_back(child->get()); } // leftmost on top
+			}
+			else { result.push_back(node); }
+		}
+		return result;
+	}
+
+	double check_sensitivities(const unit& root, const eval_context& context, double relative_step)
+	{
+		flat_circuit flat(root);
+		flat_view view = flat.view();
+		impedance_gradient gradient = impedance_sensitivities(view, context);
+		std::vector<double> values(view.characteristics, view.characteristics + view.size);
+		view.characteristics = values.data();
+		std::vector<std::complex<double>> stack(view.max_stack);
+		double size = std::abs(gradient.impedance), worst{ 0 };
+		for (std::size_t k = 0; k < gradient.components.size(); k++) {
+			std::uint32_t i = gradient.components[k];
+			double c = values[i], step = relative_step * c;
+			if (c == 0) { continue; }
+			values[i] = c + step;
+			std::complex<double> above = view.get_impedance(context, stack.data());
+			values[i] = c - step;
+			std::complex<double> below = view.get_impedance(context, stack.data());
+			values[i] = c;
+			std::complex<double> estimate = (above - below) / (2 * step);
+			double difference = std::abs(c * (estimate - gradient.derivatives[k])) / size;
+			if (!(difference <= worst)) { worst = difference; } // a NaN shows up as the answer rather than being skipped
+		}
+		return worst;
+	}
+
+	fit_result fit_components(unit& root, const std::vector<double>& omegas, const std::vector<std::complex<double>>& targets, const fit_options& options)
+	{
+		if (omegas.empty() || omegas.size() != targets.size()) { throw std::invalid_argument("fit_components: need one target per frequency"); }
+		for (std::size_t k = 0; k < omegas.size(); k++) {
+			if (!(omegas[k] > 0) || !std::isfinite(omegas[k])) { throw std::invalid_argument("fit_components: frequencies must be positive"); }
+			if (!(std::abs(targets[k]) > 0) || !std::isfinite(std::abs(targets[k]))) { throw std::invalid_argument("fit_components: targets must be finite and not zero"); }
+		}
+
+		flat_circuit flat(root);
+		flat_view view = flat.view();
+		std::vector<double> values(view.characteristics, view.characteristics + view.size);
+		view.characteristics = values.data();
+		adjoint_workspace space(view);
+		std::vector<unit*> units = component_list(root);
+		std::vector<std::size_t> free; // components being fitted, as indices into space.components
+		for (std::size_t k = 0; k < space.components.size(); k++) {
+			double c = values[space.components[k]];
+			if (c > 0 && std::isfinite(c)) { free.push_back(k); }
+		}
+		std::size_t n = free.size(), rows = 2 * omegas.size();
+		std::vector<std::complex<double>> derivatives(space.components.size());
+		fit_result result;
+
+		// residuals (real and imaginary parts of (Z - target) / |target|) and their Jacobian with respect to x = log(value)
+		// of each free component, row by row
+		std::vector<double> residuals(rows), jacobian(rows * n);
+		auto evaluate = [&](const std::vector<double>& x, bool with_jacobian) {
+			for (std::size_t f = 0; f < n; f++) { values[space.components[free[f]]] = std::exp(x[f]); }
+			double error{ 0 };
+			for (std::size_t k = 0; k < omegas.size(); k++) {
+				std::complex<double> z = forward_backward(view, omegas[k], space, derivatives.data());
+				double scale = 1 / std::abs(targets[k]);
+				std::complex<double> residual = (z - targets[k]) * scale;
+				residuals[2 * k] = residual.real(); residuals[2 * k + 1] = residual.imag();
+				error += std::norm(residual);
+				if (!with_jacobian) { continue; }
+				for (std::size_t f = 0; f < n; f++) {
+					std::complex<double> d = derivatives[free[f]] * (values[space.components[free[f]]] * scale);
+					jacobian[2 * k * n + f] = d.real(); jacobian[(2 * k + 1) * n + f] = d.imag();
+				}
+			}
+			result.evaluations++;
+			return error / static_cast<double>(omegas.size());
+		};
+
+		std::vector<double> x(n), trial(n), normal(n * n), damped(n * n), gradient(n), step(n);
+		for (std::size_t f = 0; f < n; f++) { x[f] = std::log(values[space.components[free[f]]]); }
+		double error = evaluate(x, true);
+		result.initial_error = error;
+		double damping = options.initial_damping;
+
+		while (result.iterations < options.max_iterations && n > 0) {
+			if (error <= options.tolerance) { result.converged = true; break; }
+			// normal equations J^T J and J^T r
+			std::fill(normal.begin(), normal.end(), 0.); std::fill(gradient.begin(), gradient.end(), 0.);
+			for (std::size_t r = 0; r < rows; r++) {
+				const double* row = &jacobian[r * n];
+				for (std::size_t a = 0; a < n; a++) {
+					gradient[a] += row[a] * residuals[r];
+					for (std::size_t b = 0; b <= a; b++) { normal[a * n + b] += row[a] * row[b]; }
+				}
+			}
+			result.iterations++;
+
+			// Levenberg-Marquardt: solve (J^T J + damping diag(J^T J)) step = -J^T r, raising the damping until the error falls
+			bool accepted{ false };
+			double trial_error{ 0 };
+			// components the curve hardly depends on would get enormous steps; the floor on the diagonal damps them instead
+			double floor{ 0 };
+			for (std::size_t a = 0; a < n; a++) { floor = std::max(floor, normal[a * n + a]); }
+			floor = floor > 0 ? floor * 1e-12 : 1;
+			while (damping < 1e16) {
+				damped = normal;
+				for (std::size_t a = 0; a < n; a++) { damped[a * n + a] += damping * std::max(normal[a * n + a], floor); }
+				if (cholesky_solve(damped, n, gradient, step)) {
+					// no value changes by more than a factor e at once
+					for (std::size_t f = 0; f < n; f++) { trial[f] = x[f] - std::clamp(step[f], -1., 1.); }
+					trial_error = evaluate(trial, false);
+					if (trial_error < error) { accepted = true; break; }
+				}
+				damping *= 4;
+			}
+			if (!accepted) { result.converged = true; break; } // no further progress possible at this precision
+			double improvement = (error - trial_error) / error;
+			x.swap(trial);
+			error = evaluate(x, true);
+			damping = std::max(damping / 3, 1e-12);
+			if (improvement < options.tolerance) { result.converged = true; break; }
+		}
+		if (n == 0) { result.converged = true; }
+
+		result.final_error = error;
+		for (std::size_t f = 0; f < n; f++) { set_value(*units[free[f]], std::exp(x[f])); }
+		return result;
+	}
+}
@@ -0,0 +1,59 @@
+// header file for impedance sensitivities and component fitting. The derivative of a circuit's impedance with respect to
+// every component value is found in reverse mode: one forward pass over the flattened tree records the impedance of
+// every node, then one backward pass carries dZ/dZ_node from the root down to the leaves (a series member passes its
+// parent's derivative on unchanged; a parallel member multiplies it by (Z_parent / Z_member)^2). All N derivatives
+// therefore cost about two evaluations, instead of the N + 1 that finite differences would need.
+#pragma once
+#ifndef sensitivity_h
+#define sensitivity_h
+
+#include <complex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	struct impedance_gradient
+	{
+		std::complex<double> impedance;
+		std::vector<std::uint32_t> components; // position in the flattened (postorder) arrays of each component, left to right
+		std::vector<std::complex<double>> derivatives; // dZ / d(characteristic) of each of those components
+	};
+
+	impedance_gradient impedance_sensitivities(const flat_view& circuit, const eval_context& context);
+	impedance_gradient impedance_sensitivities(const unit& root, const eval_context& context);
+
+	std::vector<unit*> component_list(unit& root); // the resistors, inductors and capacitors left to right, in the gradient's order
+
+	double check_sensitivities(const unit& root, const eval_context& context, double relative_step = 1e-6);
+	// largest difference between the reverse-mode and central finite-difference derivatives, as |c (dZ/dc)| / |Z| so that
+	// components of very different sizes are comparable; components with a zero value are skipped
+
+	struct fit_options
+	{
+		std::size_t max_iterations{ 200 };
+		double tolerance{ 1e-12 }; // stop once the error, or its relative improvement in an iteration, is below this
+		double initial_damping{ 1e-3 }; // Levenberg-Marquardt damping; larger starts closer to gradient descent
+	};
+
+	struct fit_result
+	{
+		double initial_error{ 0 }, final_error{ 0 }; // mean of |Z - target|^2 / |target|^2 over the curve
+		std::size_t iterations{ 0 };
+		std::size_t evaluations{ 0 }; // forward and backward passes over the whole curve, rejected steps included
+		bool converged{ false };
+	};
+
+	fit_result fit_components(unit& root, const std::vector<double>& omegas, const std::vector<std::complex<double>>& targets,
+		const fit_options& options = {});
+	// adjusts every component value in root to bring its impedance at omegas as close as possible to targets, by
+	// Levenberg-Marquardt on the logarithms of the values (so they stay positive), with the Jacobian from the reverse-mode
+	// pass. Each iteration solves an n x n system, so this is meant for circuits with up to a few hundred components.
+	// Components with a value of zero are left alone. Throws
+	// std::invalid_argument if the two lists differ in length or are empty, an omega is not positive, or a target is zero
+}
+
+#endif
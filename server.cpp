@@ -0,0 +1,741 @@
+#include "server.h"
+#include "unit_class.h"
+#include "flat_circuit.h"
+#include "sweep.h"
+#include "sensitivity.h"
+#include "netlist.h"
+#include "random_circuit.h"
+
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <charconv>
+#include <string_view>
+#include <stdexcept>
+#include <exception>
+#include <algorithm>
+#include <cmath>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace unit_namespace {
+
+	struct request_server::loaded_circuit
+	{
+		std::shared_mutex tree_mutex; // shared while evaluating, exclusive while a component value changes
+		std::unique_ptr<unit> tree;
+		flat_circuit flat; // what queries are evaluated on; kept in step with tree by set
+		std::vector<unit*> components; // left to right, as set numbers them
+		std::vector<std::size_t> positions; // where each of those components sits in flat
+
+		std::mutex queue_mutex;
+		std::vector<query> pending; // impedance queries waiting for the next batch
+		bool scheduled{ false }; // a batch task is queued and has not yet taken the pending queries
+	};
+
+	namespace {
+		constexpr std::size_t max_sweep_points{ 1000000 };
+		constexpr std::size_t max_random_units{ 1000000 }; // about 70 MB and 0.1 s to build; larger trees belong in a netlist
+
+		std::vector<std::string_view> split(std::string_view line)
+		{
+			std::vector<std::string_view> words;
+			std::size_t i{ 0 };
+			while (i < line.size()) {
+				while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) { i++; }
+				std::size_t start = i;
+				while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') { i++; }
+				if (i > start) { words.push_back(line.substr(start, i - start)); }
+			}
+			return words;
+		}
+
+		double number(std::string_view text)
+		{
+			double x{ 0 };
+			auto parsed = std::from_chars(text.data(), text.data() + text.size(), x);
+			if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size() || !std::isfinite(x)) {
+				throw std::invalid_argument("not a number: " + std::string(text));
+			}
+			return x;
+		}
+
+		std::size_t whole_number(std::string_view text)
+		{
+			std::size_t n{ 0 };
+			auto parsed = std::from_chars(text.data(), text.data() + text.size(), n);
+			if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) {
+				throw std::invalid_argument("not a whole number: " + std::string(text));
+			}
+			return n;
+		}
+
+		void append(std::string& out, double x)
+		{
+			char buffer[32];
+			out.append(buffer, std::to_chars(buffer, buffer + sizeof buffer, x).ptr);
+		}
+
+		void append(std::string& out, std::uint64_t n)
+		{
+			char buffer[24];
+			out.append(buffer, std::to_chars(buffer, buffer + sizeof buffer, n).ptr);
+		}
+
+		void check_words(const std::vector<std::string_view>& words, std::size_t least, std::size_t most, const char* usage)
+		{
+			if (words.size() < least || words.size() > most) { throw std::invalid_argument(std::string("usage: <id> ") + usage); }
+		}
+
+		template <typename Work> void respond(const std::string& id, const request_server::reply_function& reply, Work work)
+		// work() returns the text after "ok"; anything it throws becomes an error reply
+		{
+			std::string text;
+			try { text = id + " ok" + work(); }
+			catch (const std::exception& e) { text = id + " error " + e.what(); }
+			reply(text);
+		}
+
+		void set_value(unit& component, double value)
+		{
+			switch (component.get_kind()) {
+			case unit_kind::resistor: static_cast<resistor&>(component).set_characteristic(value); break;
+			case unit_kind::inductor: static_cast<inductor&>(component).set_characteristic(value); break;
+			default: static_cast<capacitor&>(component).set_characteristic(value); break;
+			}
+		}
+	}
+
+	request_server::request_server(const server_options& settings) : options{ settings }, pool(settings.threads)
+	{
+		if (options.max_batch == 0) { options.max_batch = 1; }
+	}
+
+	std::shared_ptr<request_server::loaded_circuit> request_server::find(const std::string& name)
+	{
+		std::shared_lock<std::shared_mutex> lock(circuits_mutex);
+		auto found = circuits.find(name);
+		if (found == circuits.end()) { throw std::invalid_argument("no circuit named " + name); }
+		return found->second;
+	}
+
+	std::string request_server::install(const std::string& name, std::unique_ptr<unit> tree)
+	{
+		auto entry = std::make_shared<loaded_circuit>();
+		entry->flat = flat_circuit(*tree);
+		entry->components = component_list(*tree);
+		for (std::size_t i = 0; i < entry->flat.size(); i++) {
+			unit_kind kind = entry->flat.get_kind(i);
+			if (kind != unit_kind::series && kind != unit_kind::parallel) { entry->positions.push_back(i); } // postorder keeps them left to right
+		}
+		entry->tree = std::move(tree);
+		std::string text = " ";
+		append(text, static_cast<std::uint64_t>(entry->flat.size())); text += ' ';
+		append(text, static_cast<std::uint64_t>(entry->components.size()));
+		std::unique_lock<std::shared_mutex> lock(circuits_mutex);
+		circuits[name] = std::move(entry); // queries already holding the old circuit still finish on it
+		return text;
+	}
+
+	void request_server::enqueue(const std::shared_ptr<loaded_circuit>& entry, query q)
+	{
+		if (!options.coalesce) {
+			pool.submit([this, entry, q] { std::vector<query> batch{ q }; evaluate(*entry, batch); });
+			return;
+		}
+		bool schedule{ false };
+		{
+			std::lock_guard<std::mutex> lock(entry->queue_mutex);
+			entry->pending.push_back(std::move(q));
+			schedule = !entry->scheduled;
+			entry->scheduled = true;
+		}
+		if (schedule) { pool.submit([this, entry] { run_batch(entry); }); }
+	}
+
+	void request_server::run_batch(const std::shared_ptr<loaded_circuit>& entry)
+	{
+		std::vector<query> batch;
+		{
+			std::lock_guard<std::mutex> lock(entry->queue_mutex);
+			if (entry->pending.size() <= options.max_batch) {
+				batch.swap(entry->pending);
+				entry->scheduled = false; // queries from here on start a new batch, which may run alongside this one
+			}
+			else {
+				auto split_point = entry->pending.begin() + static_cast<std::ptrdiff_t>(options.max_batch);
+				batch.assign(std::make_move_iterator(entry->pending.begin()), std::make_move_iterator(split_point));
+				entry->pending.erase(entry->pending.begin(), split_point);
+				pool.submit([this, entry] { run_batch(entry); }); // still scheduled: the follow-up takes the rest
+			}
+		}
+		evaluate(*entry, batch);
+	}
+
+	void request_server::evaluate(loaded_circuit& entry, std::vector<query>& batch)
+	{
+		std::size_t n = batch.size();
+		std::vector<std::string> replies(n);
+		try {
+			std::vector<double> omegas(n), real(n), imag(n);
+			for (std::size_t k = 0; k < n; k++) { omegas[k] = batch[k].omega; }
+			{
+				std::shared_lock<std::shared_mutex> lock(entry.tree_mutex);
+				sweep_impedance(entry.flat.view(), omegas.data(), n, real.data(), imag.data());
+			}
+			for (std::size_t k = 0; k < n; k++) {
+				replies[k] = batch[k].id + " ok ";
+				append(replies[k], real[k]); replies[k] += ' '; append(replies[k], imag[k]);
+			}
+		}
+		catch (const std::exception& e) {
+			for (std::size_t k = 0; k < n; k++) { replies[k] = batch[k].id + " error " + e.what(); }
+		}
+		batches++;
+		std::uint64_t largest = largest_batch.load();
+		while (n > largest && !largest_batch.compare_exchange_weak(largest, n)) {}
+		for (std::size_t k = 0; k < n; k++) { batch[k].reply(replies[k]); }
+	}
+
+	bool request_server::handle(const std::string& line, reply_function reply)
+	{
+		requests++;
+		std::vector<std::string_view> words = split(line);
+		std::string id = words.empty() ? "?" : std::string(words[0]);
+		try {
+			if (words.size() < 2) { throw std::invalid_argument("no command"); }
+			std::string_view command = words[1];
+			if (command == "impedance") {
+				check_words(words, 4, 4, "impedance <name> <omega>");
+				std::shared_ptr<loaded_circuit> entry = find(std::string(words[2]));
+				double omega = number(words[3]);
+				if (!(omega > 0)) { throw std::invalid_argument("omega must be positive"); }
+				queries++;
+				enqueue(entry, { omega, id, std::move(reply) });
+			}
+			else if (command == "sweep") {
+				check_words(words, 6, 6, "sweep <name> <from> <to> <points>");
+				std::shared_ptr<loaded_circuit> entry = find(std::string(words[2]));
+				double from = number(words[3]), to = number(words[4]);
+				std::size_t points = whole_number(words[5]);
+				if (!(from > 0 && from <= to)) { throw std::invalid_argument("need 0 < from <= to"); }
+				if (points == 0 || points > max_sweep_points) { throw std::invalid_argument("points must be between 1 and " + std::to_string(max_sweep_points)); }
+				pool.submit([entry, id, reply, from, to, points] {
+					respond(id, reply, [&] {
+						std::vector<double> omegas(points), real(points), imag(points);
+						for (std::size_t k = 0; k < points; k++) {
+							omegas[k] = points == 1 ? from : from * std::pow(to / from, static_cast<double>(k) / static_cast<double>(points - 1));
+						}
+						{
+							std::shared_lock<std::shared_mutex> lock(entry->tree_mutex);
+							sweep_impedance(entry->flat.view(), omegas.data(), points, real.data(), imag.data());
+						}
+						std::string text = " ";
+						append(text, static_cast<std::uint64_t>(points));
+						for (std::size_t k = 0; k < points; k++) { text += ' '; append(text, real[k]); text += ' '; append(text, imag[k]); }
+						return text;
+					});
+				});
+			}
+			else if (command == "set") {
+				check_words(words, 5, 5, "set <name> <component> <value>");
+				std::shared_ptr<loaded_circuit> entry = find(std::string(words[2]));
+				std::size_t index = whole_number(words[3]);
+				double value = number(words[4]);
+				if (value < 0) { throw std::invalid_argument("component values must not be negative"); } // 0 is a short, as in a netlist
+				pool.submit([entry, id, reply, index, value] {
+					respond(id, reply, [&] {
+						std::unique_lock<std::shared_mutex> lock(entry->tree_mutex);
+						if (index == 0 || index > entry->components.size()) {
+							throw std::invalid_argument("components are numbered 1 to " + std::to_string(entry->components.size()));
+						}
+						std::size_t position = entry->positions[index - 1];
+						double previous = entry->flat.get_characteristic(position);
+						set_value(*entry->components[index - 1], value);
+						entry->flat.set_characteristic(position, value);
+						std::string text = " ";
+						append(text, previous);
+						return text;
+					});
+				});
+			}
+			else if (command == "load") {
+				check_words(words, 4, 5, "load <name> <netlist file> [item]");
+				std::string name(words[2]), path(words[3]);
+				std::size_t item = words.size() == 5 ? whole_number(words[4]) : 1;
+				pool.submit([this, id, reply, name, path, item] {
+					respond(id, reply, [&] {
+						std::vector<std::unique_ptr<unit>> units = load_netlist(path);
+						if (item == 0 || item > units.size()) {
+							throw std::invalid_argument(path + " has " + std::to_string(units.size()) + " top-level items");
+						}
+						return install(name, std::move(units[item - 1]));
+					});
+				});
+			}
+			else if (command == "random") {
+				check_words(words, 4, 5, "random <name> <size> [seed]");
+				std::string name(words[2]);
+				random_circuit_options settings;
+				settings.size = whole_number(words[3]);
+				settings.seed = words.size() == 5 ? whole_number(words[4]) : 0;
+				if (settings.size == 0 || settings.size > max_random_units) { throw std::invalid_argument("size must be between 1 and " + std::to_string(max_random_units)); }
+				pool.submit([this, id, reply, name, settings] {
+					respond(id, reply, [&] { return install(name, random_circuit(settings, pool)); });
+				});
+			}
+			else if (command == "unload") {
+				check_words(words, 3, 3, "unload <name>");
+				std::unique_lock<std::shared_mutex> lock(circuits_mutex);
+				auto found = circuits.find(words[2]);
+				if (found == circuits.end()) { throw std::invalid_argument("no circuit named " + std::string(words[2])); }
+				circuits.erase(found);
+				lock.unlock();
+				reply(id + " ok");
+			}
+			else if (command == "stats") {
+				server_stats s = get_stats();
+				std::string text = id + " ok requests ";
+				append(text, s.requests); text += " queries "; append(text, s.queries);
+				text += " batches "; append(text, s.batches); text += " largest "; append(text, s.largest_batch);
+				reply(text);
+			}
+			else if (command == "quit") { reply(id + " ok"); return false; }
+			else if (command == "shutdown") { stop_requested = true; reply(id + " ok"); return false; }
+			else { throw std::invalid_argument("unknown command " + std::string(command)); }
+		}
+		catch (const std::exception& e) { reply(id + " error " + e.what()); } // only reached before reply has been handed on
+		return true;
+	}
+
+	server_stats request_server::get_stats() const
+	{
+		return { requests.load(), queries.load(), batches.load(), largest_batch.load() };
+	}
+}
+
+namespace server {
+
+	using namespace unit_namespace;
+	using clock = std::chrono::steady_clock;
+
+	namespace {
+		bool blank(const std::string& line) { return line.find_first_not_of(" \t\r") == std::string::npos; }
+
+		class pending_count // requests handed to the server whose replies have not yet been written
+		{
+		private:
+			std::mutex mutex;
+			std::condition_variable changed;
+			std::size_t count{ 0 };
+		public:
+			void add() { std::lock_guard<std::mutex> lock(mutex); count++; }
+			void remove() { std::lock_guard<std::mutex> lock(mutex); count--; changed.notify_all(); } // notified under the lock, so a waiter cannot return and destroy this first
+			void wait_zero() { std::unique_lock<std::mutex> lock(mutex); changed.wait(lock, [this] { return count == 0; }); }
+		};
+
+		void serve_stream(request_server& server, std::istream& in, std::ostream& out)
+		{
+			std::mutex output_mutex;
+			pending_count pending;
+			request_server::reply_function reply = [&](const std::string& text) {
+				{
+					std::lock_guard<std::mutex> lock(output_mutex);
+					out << text << '\n' << std::flush; // the client is waiting on it
+				}
+				pending.remove();
+			};
+			std::string line;
+			while (std::getline(in, line)) {
+				if (blank(line)) { continue; }
+				pending.add();
+				if (!server.handle(line, reply)) { break; }
+			}
+			pending.wait_zero();
+		}
+
+#ifndef _WIN32
+		class socket_connection
+		{
+		private:
+			int fd;
+			std::mutex write_mutex;
+			bool broken{ false }; // the client has gone; later replies are dropped
+		public:
+			pending_count pending;
+
+			explicit socket_connection(int descriptor) : fd{ descriptor } {}
+			~socket_connection() { ::close(fd); }
+			int descriptor() const { return fd; }
+
+			void send(const std::string& text)
+			{
+				std::string line = text + '\n';
+				std::lock_guard<std::mutex> lock(write_mutex);
+				std::size_t written{ 0 };
+				while (!broken && written < line.size()) {
+					ssize_t n = ::write(fd, line.data() + written, line.size() - written);
+					if (n < 0 && errno == EINTR) { continue; }
+					if (n <= 0) { broken = true; break; }
+					written += static_cast<std::size_t>(n);
+				}
+			}
+		};
+
+		void serve_connection(request_server& server, int fd)
+		{
+			auto connection = std::make_shared<socket_connection>(fd);
+			request_server::reply_function reply = [connection](const std::string& text) { connection->send(text); connection->pending.remove(); };
+			std::string partial;
+			char buffer[1 << 16];
+			bool open{ true };
+			while (open && !server.stopping()) {
+				pollfd watch{ fd, POLLIN, 0 };
+				int ready = ::poll(&watch, 1, 100); // wakes now and then to notice a shutdown
+				if (ready < 0 && errno != EINTR) { break; }
+				if (ready <= 0) { continue; }
+				ssize_t got = ::read(fd, buffer, sizeof buffer);
+				if (got < 0 && errno == EINTR) { continue; }
+				if (got <= 0) { break; }
+				partial.append(buffer, static_cast<std::size_t>(got));
+				std::size_t start{ 0 }, end{ 0 };
+				while (open && (end = partial.find('\n', start)) != std::string::npos) {
+					std::string line = partial.substr(start, end - start);
+					start = end + 1;
+					if (blank(line)) { continue; }
+					connection->pending.add();
+					open = server.handle(line, reply);
+				}
+				partial.erase(0, start);
+			}
+			connection->pending.wait_zero();
+			::shutdown(fd, SHUT_RDWR); // the client sees the end at once, even if a reply function outlives this
+		}
+
+		void serve_socket(request_server& server, const std::string& path)
+		{
+			std::signal(SIGPIPE, SIG_IGN); // a client that disconnects early must not kill the server
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			if (path.size() >= sizeof address.sun_path) { throw std::runtime_error("socket path too long: " + path); }
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+			struct stat existing;
+			if (::stat(path.c_str(), &existing) == 0) {
+				if (!S_ISSOCK(existing.st_mode)) { throw std::runtime_error(path + " exists and is not a socket"); }
+				::unlink(path.c_str()); // left behind by an earlier run
+			}
+			int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (listener < 0) { throw std::runtime_error("cannot create a socket"); }
+			if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0 || ::listen(listener, 64) != 0) {
+				::close(listener);
+				throw std::runtime_error("cannot listen on " + path);
+			}
+
+			struct reader { std::thread thread; std::shared_ptr<std::atomic<bool>> done; };
+			std::vector<reader> readers;
+			while (!server.stopping()) {
+				pollfd watch{ listener, POLLIN, 0 };
+				if (::poll(&watch, 1, 100) <= 0) { continue; }
+				int client = ::accept(listener, nullptr, nullptr);
+				if (client < 0) { continue; }
+				for (std::size_t i = 0; i < readers.size();) { // join the readers of connections that have closed
+					if (readers[i].done->load()) { readers[i].thread.join(); readers.erase(readers.begin() + static_cast<std::ptrdiff_t>(i)); }
+					else { i++; }
+				}
+				auto done = std::make_shared<std::atomic<bool>>(false);
+				readers.push_back({ std::thread([&server, client, done] { serve_connection(server, client); done->store(true); }), done });
+			}
+			::close(listener);
+			::unlink(path.c_str());
+			for (reader& r : readers) { r.thread.join(); }
+		}
+#else
+		void serve_socket(request_server&, const std::string&)
+		{
+			throw std::runtime_error("--socket needs Unix domain sockets, which this build does not have; use standard input and output");
+		}
+#endif
+
+		class client_link // one client's connection to a server, for the load generator
+		{
+		public:
+			virtual ~client_link() = default;
+			virtual void send(const std::string& line) = 0;
+			virtual std::string receive() = 0; // the next reply line; throws std::runtime_error if the server has gone
+		};
+
+		class local_link : public client_link // straight into a server in this process
+		{
+		private:
+			struct inbox { std::mutex mutex; std::condition_variable arrived; std::deque<std::string> replies; };
+			request_server& server;
+			std::shared_ptr<inbox> box{ std::make_shared<inbox>() };
+		public:
+			explicit local_link(request_server& s) : server{ s } {}
+			void send(const std::string& line) override
+			{
+				std::shared_ptr<inbox> target = box;
+				server.handle(line, [target](const std::string& text) {
+					std::lock_guard<std::mutex> lock(target->mutex);
+					target->replies.push_back(text);
+					target->arrived.notify_one();
+				});
+			}
+			std::string receive() override
+			{
+				std::unique_lock<std::mutex> lock(box->mutex);
+				box->arrived.wait(lock, [this] { return !box->replies.empty(); });
+				std::string text = std::move(box->replies.front());
+				box->replies.pop_front();
+				return text;
+			}
+		};
+
+#ifndef _WIN32
+		class socket_link : public client_link
+		{
+		private:
+			int fd{ -1 };
+			std::string buffered;
+		public:
+			explicit socket_link(const std::string& path)
+			{
+				sockaddr_un address{};
+				address.sun_family = AF_UNIX;
+				if (path.size() >= sizeof address.sun_path) { throw std::runtime_error("socket path too long: " + path); }
+				std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+				fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+				if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) {
+					if (fd >= 0) { ::close(fd); }
+					throw std::runtime_error("cannot connect to " + path);
+				}
+			}
+			~socket_link() override { ::close(fd); }
+			void send(const std::string& line) override
+			{
+				std::string text = line + '\n';
+				std::size_t written{ 0 };
+				while (written < text.size()) {
+					ssize_t n = ::write(fd, text.data() + written, text.size() - written);
+					if (n < 0 && errno == EINTR) { continue; }
+					if (n <= 0) { throw std::runtime_error("the server closed the connection"); }
+					written += static_cast<std::size_t>(n);
+				}
+			}
+			std::string receive() override
+			{
+				std::size_t end;
+				char buffer[1 << 16];
+				while ((end = buffered.find('\n')) == std::string::npos) {
+					ssize_t got = ::read(fd, buffer, sizeof buffer);
+					if (got < 0 && errno == EINTR) { continue; }
+					if (got <= 0) { throw std::runtime_error("the server closed the connection"); }
+					buffered.append(buffer, static_cast<std::size_t>(got));
+				}
+				std::string line = buffered.substr(0, end);
+				buffered.erase(0, end + 1);
+				return line;
+			}
+		};
+#endif
+
+		std::unique_ptr<client_link> connect_to(const std::string& socket_path, request_server* local)
+		{
+			if (local != nullptr) { return std::make_unique<local_link>(*local); }
+#ifndef _WIN32
+			return std::make_unique<socket_link>(socket_path);
+#else
+			(void)socket_path;
+			throw std::runtime_error("--socket needs Unix domain sockets, which this build does not have");
+#endif
+		}
+
+		std::string ask(client_link& link, const std::string& request) // sends one request and waits for its reply
+		{
+			link.send(request);
+			std::string reply = link.receive();
+			std::size_t space = reply.find(' ');
+			if (space == std::string::npos || reply.compare(space + 1, 2, "ok") != 0) { throw std::runtime_error("server replied: " + reply); }
+			return reply.substr(space + 3);
+		}
+
+		server_stats parse_stats(const std::string& text) // " requests R queries Q batches B largest L"
+		{
+			std::vector<std::string_view> words = split(text);
+			server_stats s;
+			for (std::size_t i = 0; i + 1 < words.size(); i += 2) {
+				std::uint64_t value = whole_number(words[i + 1]);
+				if (words[i] == "requests") { s.requests = value; }
+				else if (words[i] == "queries") { s.queries = value; }
+				else if (words[i] == "batches") { s.batches = value; }
+				else if (words[i] == "largest") { s.largest_batch = value; }
+			}
+			return s;
+		}
+
+		void run_client(client_link& link, std::size_t requests, std::size_t in_flight, std::uint64_t seed, std::vector<double>& latencies)
+		// closed loop: keeps in_flight queries outstanding, sending a new one as each reply comes back
+		{
+			std::mt19937_64 generator(seed);
+			std::uniform_real_distribution<double> decades(0, 6); // omegas log-uniform over 1 to 10^6 rad/s
+			std::vector<clock::time_point> sent(requests);
+			std::size_t next{ 0 }, received{ 0 };
+			auto send_next = [&] {
+				std::string line;
+				append(line, static_cast<std::uint64_t>(next));
+				line += " impedance load ";
+				append(line, std::pow(10., decades(generator)));
+				sent[next++] = clock::now();
+				link.send(line);
+			};
+			while (next < std::min(in_flight, requests)) { send_next(); }
+			latencies.reserve(requests);
+			while (received < requests) {
+				std::string reply = link.receive();
+				clock::time_point arrived = clock::now();
+				std::size_t space = reply.find(' ');
+				if (space == std::string::npos || reply.compare(space + 1, 3, "ok ") != 0) { throw std::runtime_error("server replied: " + reply); }
+				std::size_t id = whole_number(std::string_view(reply).substr(0, space));
+				if (id >= requests) { throw std::runtime_error("reply to an unknown request: " + reply); }
+				latencies.push_back(std::chrono::duration<double>(arrived - sent[id]).count());
+				received++;
+				if (next < requests) { send_next(); }
+			}
+		}
+
+		struct load_settings
+		{
+			std::string socket_path; // empty: start a server in this process
+			std::size_t clients{ 4 };
+			std::size_t in_flight{ 16 };
+			std::size_t requests{ 200000 }; // in total, shared between the clients
+			std::size_t size{ 300 };
+			std::size_t threads{ 0 };
+		};
+
+		void load_run(const load_settings& settings, const char* label, request_server* local)
+		{
+			std::unique_ptr<client_link> control = connect_to(settings.socket_path, local);
+			ask(*control, "setup random load " + std::to_string(settings.size) + " 1");
+			server_stats before = parse_stats(ask(*control, "before stats"));
+
+			std::vector<std::vector<double>> latencies(settings.clients);
+			std::vector<std::unique_ptr<client_link>> links;
+			for (std::size_t c = 0; c < settings.clients; c++) { links.push_back(connect_to(settings.socket_path, local)); }
+			std::vector<std::thread> threads;
+			std::vector<std::exception_ptr> errors(settings.clients);
+			clock::time_point start = clock::now();
+			for (std::size_t c = 0; c < settings.clients; c++) {
+				std::size_t share = settings.requests / settings.clients + (c < settings.requests % settings.clients ? 1 : 0);
+				threads.emplace_back([&, c, share] {
+					try { run_client(*links[c], share, settings.in_flight, c + 1, latencies[c]); }
+					catch (...) { errors[c] = std::current_exception(); }
+				});
+			}
+			for (std::thread& t : threads) { t.join(); }
+			double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			for (const std::exception_ptr& e : errors) { if (e) { std::rethrow_exception(e); } }
+			server_stats after = parse_stats(ask(*control, "after stats"));
+			ask(*control, "done unload load");
+
+			std::vector<double> all;
+			for (const std::vector<double>& l : latencies) { all.insert(all.end(), l.begin(), l.end()); }
+			std::sort(all.begin(), all.end());
+			auto percentile = [&](double q) { return all.empty() ? 0. : all[static_cast<std::size_t>(q * static_cast<double>(all.size() - 1))] * 1e6; };
+			std::uint64_t batches = after.batches - before.batches;
+			std::cout << std::left << std::setw(16) << label << std::right << std::fixed << std::setprecision(0)
+				<< std::setw(14) << static_cast<double>(all.size()) / elapsed
+				<< std::setprecision(1) << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.9)
+				<< std::setw(10) << percentile(0.99) << std::setw(10) << (all.empty() ? 0. : all.back() * 1e6)
+				<< std::setprecision(2) << std::setw(16) << (batches ? static_cast<double>(after.queries - before.queries) / static_cast<double>(batches) : 0.)
+				<< std::defaultfloat << std::endl;
+		}
+
+		template <typename Parse> int guarded(const char* mode, const std::vector<std::string>& arguments, const char* usage, Parse parse)
+		// parses the arguments, printing the usage and returning 2 if they are wrong, then runs
+		{
+			std::function<void()> body;
+			try { body = parse(arguments); }
+			catch (const std::exception& e) { std::cerr << mode << ": " << e.what() << '\n' << "usage: " << usage << std::endl; return 2; }
+			try { body(); }
+			catch (const std::exception& e) { std::cerr << mode << ": " << e.what() << std::endl; return 1; }
+			return 0;
+		}
+
+		std::size_t count_argument(const std::vector<std::string>& arguments, std::size_t& i)
+		{
+			if (i + 1 >= arguments.size()) { throw std::invalid_argument(arguments[i] + " needs a value"); }
+			return whole_number(arguments[++i]);
+		}
+	}
+
+	int run(const std::vector<std::string>& arguments)
+	{
+		return guarded("serve", arguments, "--serve [--socket path] [--threads n] [--no-coalesce] [--max-batch n]",
+			[](const std::vector<std::string>& args) -> std::function<void()> {
+				server_options options;
+				std::string socket_path;
+				for (std::size_t i = 0; i < args.size(); i++) {
+					if (args[i] == "--socket" && i + 1 < args.size()) { socket_path = args[++i]; }
+					else if (args[i] == "--threads") { options.threads = count_argument(args, i); }
+					else if (args[i] == "--no-coalesce") { options.coalesce = false; }
+					else if (args[i] == "--max-batch") { options.max_batch = count_argument(args, i); }
+					else { throw std::invalid_argument("unexpected argument: " + args[i]); }
+				}
+				return [options, socket_path] {
+					request_server server(options);
+					if (socket_path.empty()) { serve_stream(server, std::cin, std::cout); }
+					else { serve_socket(server, socket_path); }
+				};
+			});
+	}
+
+	int load_test(const std::vector<std::string>& arguments)
+	{
+		return guarded("serve-load", arguments,
+			"--serve-load [--socket path] [--clients n] [--in-flight n] [--requests n] [--size units] [--threads n]",
+			[](const std::vector<std::string>& args) -> std::function<void()> {
+				load_settings settings;
+				for (std::size_t i = 0; i < args.size(); i++) {
+					if (args[i] == "--socket" && i + 1 < args.size()) { settings.socket_path = args[++i]; }
+					else if (args[i] == "--clients") { settings.clients = count_argument(args, i); }
+					else if (args[i] == "--in-flight") { settings.in_flight = count_argument(args, i); }
+					else if (args[i] == "--requests") { settings.requests = count_argument(args, i); }
+					else if (args[i] == "--size") { settings.size = count_argument(args, i); }
+					else if (args[i] == "--threads") { settings.threads = count_argument(args, i); }
+					else { throw std::invalid_argument("unexpected argument: " + args[i]); }
+				}
+				if (settings.clients == 0 || settings.in_flight == 0 || settings.size == 0) {
+					throw std::invalid_argument("--clients, --in-flight and --size must be at least 1");
+				}
+				return [settings] {
+					std::cout << settings.clients << " clients x " << settings.in_flight << " in flight, " << settings.requests
+						<< " impedance queries against a random circuit of " << settings.size << " units" << std::endl;
+					std::cout << std::left << std::setw(16) << "server" << std::right << std::setw(14) << "queries/s" << std::setw(10) << "p50 us"
+						<< std::setw(10) << "p90 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::setw(16) << "queries/batch" << std::endl;
+					if (!settings.socket_path.empty()) { load_run(settings, settings.socket_path.c_str(), nullptr); return; }
+					for (bool coalesce : { true, false }) {
+						server_options options;
+						options.threads = settings.threads;
+						options.coalesce = coalesce;
+						request_server local(options);
+						load_run(settings, coalesce ? "coalesced" : "one at a time", &local);
+					}
+				};
+			});
+	}
+}
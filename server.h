@@ -0,0 +1,100 @@
+// header file for the request server, which keeps circuits loaded in a long-lived process and answers queries about
+// them. Requests are text lines, read from standard input or from clients of a Unix domain socket, each starting with
+// an id the client chooses:
+//   <id> load <name> <netlist file> [item]    item-th (default first) top-level item of a tree netlist
+//   <id> random <name> <size> [seed]          a random_circuit with that many units, at most 10^6
+//   <id> impedance <name> <omega>             replies ok <real> <imag>
+//   <id> sweep <name> <from> <to> <points>    logarithmically spaced; replies ok <points> then real and imag of each
+//   <id> set <name> <component> <value>       components numbered from 1, left to right; replies ok <previous value>.
+//                                             As in a netlist, 0 is allowed: a resistor or inductor becomes a short, a capacitor an open
+//   <id> unload <name>, <id> stats, <id> quit (closes this connection), <id> shutdown (stops the server)
+// load and random reply ok <nodes> <components>. Every request gets exactly one reply line, starting with its id and
+// then "ok ..." or "error <message>". Requests run concurrently on a thread pool, so replies may come back in a
+// different order; a client that needs an order (a set before an impedance, say) waits for the first reply.
+//
+// Impedance queries against one circuit are coalesced. A query joins the circuit's queue, and the query that finds the
+// queue idle schedules a batch task; when that task runs it takes everything that has arrived by then and evaluates
+// it in one multi-frequency sweep (sweep.h). Nothing waits on a timer, so a lone query is answered at once and batches
+// grow by themselves as the load rises. Results come from the batched SIMD kernels, so they agree with get_impedance
+// to rounding rather than bit for bit; shorted members and open capacitors give the same values as get_impedance.
+#pragma once
+#ifndef server_h
+#define server_h
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <shared_mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "unit_class.h"
+#include "thread_pool.h"
+
+namespace unit_namespace {
+
+	struct server_options
+	{
+		std::size_t threads{ 0 }; // zero means one per hardware core
+		bool coalesce{ true }; // off evaluates every impedance query on its own, for comparison
+		std::size_t max_batch{ 4096 }; // most queries evaluated in one sweep; the rest go to a follow-up batch
+	};
+
+	struct server_stats
+	{
+		std::uint64_t requests{ 0 };
+		std::uint64_t queries{ 0 }; // impedance requests
+		std::uint64_t batches{ 0 }; // sweeps those queries were answered by
+		std::uint64_t largest_batch{ 0 };
+	};
+
+	class request_server
+	{
+	public:
+		using reply_function = std::function<void(const std::string&)>;
+	private:
+		struct loaded_circuit;
+		struct query { double omega; std::string id; reply_function reply; };
+
+		server_options options;
+		std::shared_mutex circuits_mutex;
+		std::map<std::string, std::shared_ptr<loaded_circuit>, std::less<>> circuits;
+		std::atomic<std::uint64_t> requests{ 0 }, queries{ 0 }, batches{ 0 }, largest_batch{ 0 };
+		std::atomic<bool> stop_requested{ false };
+		thread_pool pool; // last, so its workers finish before anything they use is destroyed
+
+		std::shared_ptr<loaded_circuit> find(const std::string& name);
+		std::string install(const std::string& name, std::unique_ptr<unit> tree); // returns " <nodes> <components>" for the reply
+		void enqueue(const std::shared_ptr<loaded_circuit>& entry, query q);
+		void run_batch(const std::shared_ptr<loaded_circuit>& entry);
+		void evaluate(loaded_circuit& entry, std::vector<query>& batch);
+	public:
+		explicit request_server(const server_options& settings = {});
+		request_server(const request_server&) = delete;
+		request_server& operator=(const request_server&) = delete;
+
+		bool handle(const std::string& line, reply_function reply);
+		// reply is called exactly once, on this or a pool thread, with the reply line (no newline); it must be safe to
+		// call from any thread. Returns false after a quit or shutdown request. line must not be blank
+		bool stopping() const { return stop_requested.load(); }
+		server_stats get_stats() const;
+	};
+}
+
+namespace server {
+
+	int run(const std::vector<std::string>& arguments);
+	// --serve [--socket path] [--threads n] [--no-coalesce] [--max-batch n]; reads standard input and writes standard
+	// output unless --socket is given. Returns the process exit code
+
+	int load_test(const std::vector<std::string>& arguments);
+	// --serve-load [--socket path] [--clients n] [--in-flight n] [--requests n] [--size units] [--threads n]
+	// Load generator: each client keeps in-flight impedance queries outstanding against one random circuit and the
+	// latency of every reply is recorded, then throughput and latency percentiles are printed. With --socket it drives
+	// a server that is already running; otherwise it starts one in this process and runs twice, with and without
+	// coalescing, so the two can be compared
+}
+
+#endif
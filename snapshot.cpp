@@ -0,0 +1,119 @@
+#include "snapshot.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace unit_namespace {
+
+	namespace {
+		constexpr char snapshot_magic[8]{ 'A', 'C', 'M', 'S', 'N', 'A', 'P', '\0' };
+		constexpr std::size_t header_bytes{ 32 };
+
+		bool little_endian_host()
+		{
+			const std::uint16_t probe{ 1 };
+			unsigned char first;
+			std::memcpy(&first, &probe, 1);
+			return first == 1;
+		}
+
+		template<typename T> T byte_swapped(T value) // reverses the bytes of any trivially copyable value
+		{
+			unsigned char bytes[sizeof(T)];
+			std::memcpy(bytes, &value, sizeof(T));
+			for (std::size_t i = 0; i < sizeof(T) / 2; i++) { std::swap(bytes[i], bytes[sizeof(T) - 1 - i]); }
+			std::memcpy(&value, bytes, sizeof(T));
+			return value;
+		}
+
+		template<typename T> void write_little_endian(std::ostream& out, const T* values, std::size_t count)
+		{
+			if (little_endian_host()) { out.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(T))); return; }
+			for (std::size_t i = 0; i < count; i++) {
+				T swapped = byte_swapped(values[i]);
+				out.write(reinterpret_cast<const char*>(&swapped), sizeof(T));
+			}
+		}
+
+		template<typename T> T read_little_endian(const char* p)
+		{
+			T value;
+			std::memcpy(&value, p, sizeof(T));
+			return little_endian_host() ? value : byte_swapped(value);
+		}
+	}
+
+	void write_snapshot(std::ostream& out, const flat_view& circuit)
+	{
+		std::uint32_t version{ snapshot_version }, reserved{ 0 };
+		std::uint64_t count{ circuit.size }, stack{ circuit.max_stack };
+		out.write(snapshot_magic, sizeof(snapshot_magic));
+		write_little_endian(out, &version, 1);
+		write_little_endian(out, &reserved, 1);
+		write_little_endian(out, &count, 1);
+		write_little_endian(out, &stack, 1);
+		write_little_endian(out, circuit.characteristics, circuit.size);
+		write_little_endian(out, circuit.arities, circuit.size);
+		write_little_endian(out, circuit.kinds, circuit.size);
+	}
+
+	void write_snapshot(const std::string& path, const unit& root)
+	{
+		flat_circuit flat(root);
+		std::ofstream out(path, std::ios::binary);
+		if (!out) { throw std::runtime_error("Cannot create " + path); }
+		write_snapshot(out, flat.view());
+		if (!out) { throw std::runtime_error("Cannot write " + path); }
+	}
+
+	circuit_snapshot::circuit_snapshot(const std::string& path) : file(path)
+	{
+		const char* p = file.data();
+		if (file.size() < header_bytes || std::memcmp(p, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+			throw std::runtime_error(path + " is not a circuit snapshot");
+		}
+		std::uint32_t version = read_little_endian<std::uint32_t>(p + 8);
+		if (version != snapshot_version) { throw std::runtime_error(path + " has unsupported snapshot version " + std::to_string(version)); }
+		std::uint64_t count = read_little_endian<std::uint64_t>(p + 16);
+		std::uint64_t stack = read_little_endian<std::uint64_t>(p + 24);
+		if (count > (file.size() - header_bytes) / 13 || file.size() != header_bytes + count * 13) { // 8 + 4 + 1 bytes per node
+			throw std::runtime_error(path + " is truncated or has trailing data");
+		}
+
+		circuit.size = static_cast<std::size_t>(count);
+		circuit.max_stack = static_cast<std::size_t>(stack);
+		const char* characteristics = p + header_bytes;
+		const char* arities = characteristics + count * 8;
+		circuit.kinds = reinterpret_cast<const std::uint8_t*>(arities + count * 4);
+		if (little_endian_host()) {
+			circuit.characteristics = reinterpret_cast<const double*>(characteristics);
+			circuit.arities = reinterpret_cast<const std::uint32_t*>(arities);
+		}
+		else {
+			swapped_characteristics.resize(circuit.size); swapped_arities.resize(circuit.size);
+			for (std::size_t i = 0; i < circuit.size; i++) {
+				swapped_characteristics[i] = read_little_endian<double>(characteristics + i * 8);
+				swapped_arities[i] = read_little_endian<std::uint32_t>(arities + i * 4);
+			}
+			circuit.characteristics = swapped_characteristics.data();
+			circuit.arities = swapped_arities.data();
+		}
+
+		// replay the evaluation stack once so a corrupt file is rejected here rather than read out of bounds later
+		std::uint64_t depth{ 0 }, deepest{ 0 };
+		for (std::size_t i = 0; i < circuit.size; i++) {
+			std::uint8_t kind = circuit.kinds[i];
+			if (kind > static_cast<std::uint8_t>(unit_kind::parallel)) { throw std::runtime_error(path + " has an unknown unit kind"); }
+			bool is_circuit = kind == static_cast<std::uint8_t>(unit_kind::series) || kind == static_cast<std::uint8_t>(unit_kind::parallel);
+			std::uint32_t arity = circuit.arities[i];
+			if ((!is_circuit && arity != 0) || arity > depth) { throw std::runtime_error(path + " has an inconsistent topology"); }
+			depth = depth - arity + 1;
+			deepest = std::max(deepest, depth);
+		}
+		if (circuit.size != 0 && depth != 1) { throw std::runtime_error(path + " does not hold exactly one tree"); }
+		if (deepest != stack) { throw std::runtime_error(path + " records a stack depth that does not match its topology"); }
+	}
+}
@@ -0,0 +1,51 @@
+// header file for binary circuit snapshots. A snapshot is the flattened form of a unit tree written straight to disk,
+// so it can be memory-mapped back and evaluated in place without rebuilding any unit objects.
+//
+// Layout, all little-endian, version 1:
+//   offset 0   8 bytes   magic "ACMSNAP" followed by a zero byte
+//   offset 8   u32       format version
+//   offset 12  u32       reserved, zero
+//   offset 16  u64       node count n
+//   offset 24  u64       evaluation stack depth (max_stack)
+//   offset 32  n x f64   characteristics, postorder
+//   then       n x u32   number of children of each node
+//   then       n x u8    unit_kind of each node
+// Every array starts on a boundary suited to its element type, so a mapped file can be used without copying.
+#pragma once
+#ifndef snapshot_h
+#define snapshot_h
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+#include "mapped_file.h"
+
+namespace unit_namespace {
+
+	constexpr std::uint32_t snapshot_version{ 1 };
+
+	void write_snapshot(std::ostream& out, const flat_view& circuit);
+	void write_snapshot(const std::string& path, const unit& root); // flattens then writes; throws std::runtime_error on I/O failure
+
+	class circuit_snapshot // a snapshot file opened for evaluation
+	{
+	private:
+		mapped_file file;
+		flat_view circuit;
+		std::vector<double> swapped_characteristics; // only used on big-endian hosts, which cannot read the file in place
+		std::vector<std::uint32_t> swapped_arities;
+	public:
+		explicit circuit_snapshot(const std::string& path);
+		// maps the file and checks the header, the topology and that the stored stack depth is the one the topology needs;
+		// throws std::runtime_error if it is not a valid snapshot
+
+		const flat_view& view() const { return circuit; } // points into the mapping on little-endian hosts
+		std::complex<double> get_impedance(const eval_context& context) const { return circuit.get_impedance(context); }
+	};
+}
+
+#endif
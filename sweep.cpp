@@ -0,0 +1,223 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <complex>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace unit_namespace {
+
+	namespace {
+		// thin wrapper over whichever double-precision vector unit the target has, so each kernel is written once
+
+		inline bool ordinary(double d) { return d > 0 && d < std::numeric_limits<double>::infinity(); } // safe to divide by
+
+#if defined(__AVX__)
+		using pack = __m256d;
+		constexpr std::size_t pack_width{ 4 };
+		inline pack load(const double* p) { return _mm256_loadu_pd(p); }
+		inline void store(double* p, pack v) { _mm256_storeu_pd(p, v); }
+		inline pack broadcast(double x) { return _mm256_set1_pd(x); }
+		inline pack add(pack a, pack b) { return _mm256_add_pd(a, b); }
+		inline pack mul(pack a, pack b) { return _mm256_mul_pd(a, b); }
+		inline pack div(pack a, pack b) { return _mm256_div_pd(a, b); }
+		inline pack neg(pack a) { return _mm256_sub_pd(_mm256_setzero_pd(), a); }
+		inline bool all_ordinary(pack d) // every lane strictly between zero and infinity
+		{
+			__m256d low = _mm256_cmp_pd(d, _mm256_setzero_pd(), _CMP_GT_OQ);
+			__m256d high = _mm256_cmp_pd(d, _mm256_set1_pd(std::numeric_limits<double>::infinity()), _CMP_LT_OQ);
+			return _mm256_movemask_pd(_mm256_and_pd(low, high)) == 0xF;
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		using pack = float64x2_t;
+		constexpr std::size_t pack_width{ 2 };
+		inline pack load(const double* p) { return vld1q_f64(p); }
+		inline void store(double* p, pack v) { vst1q_f64(p, v); }
+		inline pack broadcast(double x) { return vdupq_n_f64(x); }
+		inline pack add(pack a, pack b) { return vaddq_f64(a, b); }
+		inline pack mul(pack a, pack b) { return vmulq_f64(a, b); }
+		inline pack div(pack a, pack b) { return vdivq_f64(a, b); }
+		inline pack neg(pack a) { return vnegq_f64(a); }
+		inline bool all_ordinary(pack d)
+		{
+			uint64x2_t inside = vandq_u64(vcgtq_f64(d, vdupq_n_f64(0)), vcltq_f64(d, vdupq_n_f64(std::numeric_limits<double>::infinity())));
+			return vgetq_lane_u64(inside, 0) != 0 && vgetq_lane_u64(inside, 1) != 0;
+		}
+#else
+		using pack = double;
+		constexpr std::size_t pack_width{ 1 };
+		inline pack load(const double* p) { return *p; }
+		inline void store(double* p, pack v) { *p = v; }
+		inline pack broadcast(double x) { return x; }
+		inline pack add(pack a, pack b) { return a + b; }
+		inline pack mul(pack a, pack b) { return a * b; }
+		inline pack div(pack a, pack b) { return a / b; }
+		inline pack neg(pack a) { return -a; }
+		inline bool all_ordinary(pack d) { return ordinary(d); }
+#endif
+
+		// the kernels below handle whole packs and then finish the remainder with the scalar formula
+
+		void resistor_kernel(double c, std::size_t n, double* re, double* im)
+		{
+			for (std::size_t k = 0; k < n; k++) { re[k] = c; im[k] = 0; }
+		}
+
+		void inductor_kernel(double c, const double* w, std::size_t n, double* re, double* im) // Z = jwL
+		{
+			std::size_t k{ 0 };
+			pack vc = broadcast(c), zero = broadcast(0);
+			for (; k + pack_width <= n; k += pack_width) {
+				store(re + k, zero); store(im + k, mul(vc, load(w + k)));
+			}
+			for (; k < n; k++) { re[k] = 0; im[k] = c * w[k]; }
+		}
+
+		void capacitor_kernel(double c, const double* w, std::size_t n, double* re, double* im) // Z = -j/(wC)
+		{
+			std::size_t k{ 0 };
+			pack vc = broadcast(c), zero = broadcast(0), minus_one = broadcast(-1.);
+			for (; k + pack_width <= n; k += pack_width) {
+				store(re + k, zero); store(im + k, div(minus_one, mul(vc, load(w + k))));
+			}
+			for (; k < n; k++) { re[k] = 0; im[k] = -1. / (c * w[k]); }
+		}
+
+		void add_kernel(std::size_t n, double* acc_re, double* acc_im, const double* re, const double* im) // series sum
+		{
+			std::size_t k{ 0 };
+			for (; k + pack_width <= n; k += pack_width) {
+				store(acc_re + k, add(load(acc_re + k), load(re + k)));
+				store(acc_im + k, add(load(acc_im + k), load(im + k)));
+			}
+			for (; k < n; k++) { acc_re[k] += re[k]; acc_im[k] += im[k]; }
+		}
+
+		void exact_reciprocal_add(std::size_t begin, std::size_t end, double* acc_re, double* acc_im, const double* re, const double* im)
+		{
+			for (std::size_t k = begin; k < end; k++) {
+				std::complex<double> r = 1. / std::complex<double>{ re[k], im[k] };
+				acc_re[k] += r.real(); acc_im[k] += r.imag();
+			}
+		}
+
+		void exact_reciprocal(std::size_t begin, std::size_t end, const double* re, const double* im, double* out_re, double* out_im)
+		{
+			for (std::size_t k = begin; k < end; k++) {
+				std::complex<double> r = 1. / std::complex<double>{ re[k], im[k] };
+				out_re[k] = r.real(); out_im[k] = r.imag();
+			}
+		}
+
+		void reciprocal_add_kernel(std::size_t n, double* acc_re, double* acc_im, const double* re, const double* im)
+		// parallel sum; acc += 1/z using 1/(a+jb) = (a-jb)/(a^2+b^2). Where a^2+b^2 is zero, infinite or NaN (a shorted
+		// member, a capacitor at DC, or overflow) that formula gives NaN, so those points take std::complex division
+		// instead, which is what get_impedance does and which turns a short into a zero and an open into nothing
+		{
+			std::size_t k{ 0 };
+			for (; k + pack_width <= n; k += pack_width) {
+				pack a = load(re + k), b = load(im + k);
+				pack d = add(mul(a, a), mul(b, b));
+				if (!all_ordinary(d)) { exact_reciprocal_add(k, k + pack_width, acc_re, acc_im, re, im); continue; }
+				store(acc_re + k, add(load(acc_re + k), div(a, d)));
+				store(acc_im + k, add(load(acc_im + k), div(neg(b), d)));
+			}
+			for (; k < n; k++) {
+				double d = re[k] * re[k] + im[k] * im[k];
+				if (!ordinary(d)) { exact_reciprocal_add(k, k + 1, acc_re, acc_im, re, im); continue; }
+				acc_re[k] += re[k] / d; acc_im[k] += -im[k] / d;
+			}
+		}
+
+		void reciprocal_kernel(std::size_t n, const double* re, const double* im, double* out_re, double* out_im)
+		// out = 1/z, with the same fallback as reciprocal_add_kernel
+		{
+			std::size_t k{ 0 };
+			for (; k + pack_width <= n; k += pack_width) {
+				pack a = load(re + k), b = load(im + k);
+				pack d = add(mul(a, a), mul(b, b));
+				if (!all_ordinary(d)) { exact_reciprocal(k, k + pack_width, re, im, out_re, out_im); continue; }
+				store(out_re + k, div(a, d)); store(out_im + k, div(neg(b), d));
+			}
+			for (; k < n; k++) {
+				double d = re[k] * re[k] + im[k] * im[k];
+				if (!ordinary(d)) { exact_reciprocal(k, k + 1, re, im, out_re, out_im); continue; }
+				out_re[k] = re[k] / d; out_im[k] = -im[k] / d;
+			}
+		}
+	}
+
+	void sweep_combine(unit_kind kind, std::size_t arity, std::size_t n, double* re, double* im, double* scratch_re, double* scratch_im)
+	{
+		if (kind == unit_kind::series) {
+			if (arity == 0) { resistor_kernel(0, n, re, im); }
+			for (std::size_t j = 1; j < arity; j++) { add_kernel(n, re, im, re + j * sweep_block, im + j * sweep_block); }
+			return;
+		}
+		resistor_kernel(0, n, scratch_re, scratch_im);
+		for (std::size_t j = 0; j < arity; j++) { reciprocal_add_kernel(n, scratch_re, scratch_im, re + j * sweep_block, im + j * sweep_block); }
+		reciprocal_kernel(n, scratch_re, scratch_im, re, im);
+	}
+
+	void sweep_impedance(const flat_view& circuit, const double* omegas, std::size_t count, double* real, double* imag)
+	{
+		if (circuit.size == 0) {
+			for (std::size_t k = 0; k < count; k++) { real[k] = 0; imag[k] = 0; }
+			return;
+		}
+		// one row of sweep_block frequencies per stack slot, plus one scratch row for the parallel accumulator
+		std::vector<double> stack_re((circuit.max_stack + 1) * sweep_block), stack_im((circuit.max_stack + 1) * sweep_block);
+		double* acc_re = stack_re.data() + circuit.max_stack * sweep_block;
+		double* acc_im = stack_im.data() + circuit.max_stack * sweep_block;
+
+		for (std::size_t start = 0; start < count; start += sweep_block) {
+			std::size_t n = std::min(sweep_block, count - start);
+			const double* w = omegas + start;
+			std::size_t top{ 0 };
+			for (std::size_t i = 0; i < circuit.size; i++) {
+				double c = circuit.characteristics[i];
+				std::size_t arity = circuit.arities[i];
+				unit_kind kind = static_cast<unit_kind>(circuit.kinds[i]);
+				switch (kind) {
+				case unit_kind::resistor:
+					resistor_kernel(c, n, &stack_re[top * sweep_block], &stack_im[top * sweep_block]); top++; break;
+				case unit_kind::inductor:
+					inductor_kernel(c, w, n, &stack_re[top * sweep_block], &stack_im[top * sweep_block]); top++; break;
+				case unit_kind::capacitor:
+					capacitor_kernel(c, w, n, &stack_re[top * sweep_block], &stack_im[top * sweep_block]); top++; break;
+				case unit_kind::series:
+				case unit_kind::parallel: {
+					std::size_t first = top - arity;
+					sweep_combine(kind, arity, n, &stack_re[first * sweep_block], &stack_im[first * sweep_block], acc_re, acc_im);
+					top = first + 1;
+					break;
+				}
+				}
+			}
+			std::copy(stack_re.begin(), stack_re.begin() + n, real + start);
+			std::copy(stack_im.begin(), stack_im.begin() + n, imag + start);
+		}
+	}
+
+	std::vector<std::complex<double>> sweep_impedance(const flat_view& circuit, const std::vector<double>& omegas)
+	{
+		UNIT_TIME(sweep, "sweep_impedance");
+		std::vector<double> real(omegas.size()), imag(omegas.size());
+		sweep_impedance(circuit, omegas.data(), omegas.size(), real.data(), imag.data());
+		std::vector<std::complex<double>> result(omegas.size());
+		for (std::size_t k = 0; k < omegas.size(); k++) { result[k] = std::complex<double>{ real[k], imag[k] }; }
+		return result;
+	}
+
+	std::vector<std::complex<double>> sweep_impedance(const unit& root, const std::vector<double>& omegas)
+	{
+		UNIT_TIME(sweep, "sweep_impedance");
+		flat_circuit flat(root);
+		return sweep_impedance(flat.view(), omegas);
+	}
+}
@@ -0,0 +1,30 @@
+// header file for batched frequency sweeps. All frequencies are pushed through one traversal of the flattened tree,
+// a block of frequencies at a time, with the component formulas and series/parallel combines done by vector kernels
+// over split real and imaginary arrays.
+#pragma once
+#ifndef sweep_h
+#define sweep_h
+
+#include <complex>
+#include <vector>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	constexpr std::size_t sweep_block{ 256 }; // frequencies evaluated together; keeps the working stack in L1/L2 cache
+
+	void sweep_combine(unit_kind kind, std::size_t arity, std::size_t n, double* re, double* im, double* scratch_re, double* scratch_im);
+	// series or parallel combine of the first n values of arity rows, sweep_block apart, starting at re and im; the
+	// result goes to the first row. scratch holds one row. Shorted and open members give what get_impedance gives
+
+	void sweep_impedance(const flat_view& circuit, const double* omegas, std::size_t count, double* real, double* imag);
+	// core kernel; writes the real and imaginary parts of the impedance at each omega into the two output arrays
+
+	std::vector<std::complex<double>> sweep_impedance(const flat_view& circuit, const std::vector<double>& omegas);
+	std::vector<std::complex<double>> sweep_impedance(const unit& root, const std::vector<double>& omegas);
+	// convenience overloads; the unit one flattens the tree first
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include "thread_pool.h"
+
+#include <exception>
+#include <algorithm>
+
+namespace unit_namespace {
+
+	namespace {
+		thread_local const thread_pool* current_pool{ nullptr }; // lets tasks spawned by a worker go to its own deque
+		thread_local std::size_t current_index{ 0 };
+	}
+
+	thread_pool::thread_pool(std::size_t threads)
+	{
+		if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+		for (std::size_t i = 0; i < threads; i++) { queues.push_back(std::make_unique<worker_queue>()); }
+		for (std::size_t i = 0; i < threads; i++) { workers.emplace_back(&thread_pool::worker_loop, this, i); }
+	}
+
+	thread_pool::~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			stopping = true;
+		}
+		idle.notify_all();
+		for (auto& worker : workers) { worker.join(); }
+	}
+
+	void thread_pool::push(std::size_t index, std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queues[index]->mutex);
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex); // pairs with the wait predicate so a wake-up cannot be missed
+			queued++;
+		}
+		idle.notify_one();
+	}
+
+	void thread_pool::submit(std::function<void()> task)
+	{
+		std::size_t index = current_pool == this ? current_index : next_queue++ % queues.size();
+		push(index, std::move(task));
+	}
+
+	bool thread_pool::try_run_one(std::size_t home)
+	{
+		std::function<void()> task;
+		for (std::size_t k = 0; k < queues.size() && !task; k++) {
+			std::size_t index = (home + k) % queues.size();
+			std::lock_guard<std::mutex> lock(queues[index]->mutex);
+			auto& tasks = queues[index]->tasks;
+			if (tasks.empty()) { continue; }
+			if (k == 0) { task = std::move(tasks.back()); tasks.pop_back(); } // own work: newest first, still warm in cache
+			else { task = std::move(tasks.front()); tasks.pop_front(); } // stolen work: oldest first, usually the biggest
+		}
+		if (!task) { return false; }
+		queued--;
+		task();
+		return true;
+	}
+
+	void thread_pool::worker_loop(std::size_t index)
+	{
+		current_pool = this; current_index = index;
+		while (true) {
+			if (try_run_one(index)) { continue; }
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			idle.wait(lock, [this] { return stopping || queued > 0; });
+			if (stopping && queued == 0) { return; }
+		}
+	}
+
+	void thread_pool::parallel_for(std::size_t count, std::size_t chunk, const std::function<void(std::size_t, std::size_t)>& body)
+	{
+		if (count == 0) { return; }
+		if (chunk == 0) { chunk = 1; }
+		std::size_t pieces = (count + chunk - 1) / chunk;
+		std::atomic<std::size_t> remaining{ pieces };
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		// deal the pieces out in contiguous runs so each worker starts on its own stretch and only steals at the end
+		std::size_t per_queue = (pieces + queues.size() - 1) / queues.size();
+		for (std::size_t p = 0; p < pieces; p++) {
+			std::size_t begin = p * chunk, end = std::min(count, begin + chunk);
+			push(p / per_queue, [&, begin, end] {
+				try { body(begin, end); }
+				catch (...) {
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error) { error = std::current_exception(); }
+				}
+				if (--remaining == 0) { // only members from here on: the caller may already have returned
+					{ std::lock_guard<std::mutex> lock(idle_mutex); } // the caller is either before its check or waiting
+					idle.notify_all();
+				}
+			});
+		}
+
+		std::size_t home = current_pool == this ? current_index : 0;
+		while (remaining > 0) {
+			if (try_run_one(home)) { continue; }
+			// everything left is already running elsewhere: sleep until the last piece is done, or new work (a nested
+			// parallel_for, say) is queued that this thread can help with
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			idle.wait(lock, [&] { return remaining == 0 || queued > 0; });
+		}
+		if (error) { std::rethrow_exception(error); }
+	}
+}
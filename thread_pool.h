@@ -0,0 +1,50 @@
+// header file for a small work-stealing thread pool. Each worker owns a task deque: it takes work from the back of its own
+// deque and, when that runs dry, steals from the front of the others. Used to spread sweeps and lists over cores.
+#pragma once
+#ifndef thread_pool_h
+#define thread_pool_h
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+
+namespace unit_namespace {
+
+	class thread_pool
+	{
+	private:
+		struct worker_queue { std::mutex mutex; std::deque<std::function<void()>> tasks; };
+
+		std::vector<std::unique_ptr<worker_queue>> queues; // one per worker
+		std::vector<std::thread> workers;
+		std::mutex idle_mutex;
+		std::condition_variable idle; // sleeping workers wait here for new tasks
+		std::atomic<std::size_t> queued{ 0 }; // tasks sitting in any deque
+		std::atomic<std::size_t> next_queue{ 0 }; // round-robin target for tasks submitted from outside the pool
+		bool stopping{ false };
+
+		bool try_run_one(std::size_t home); // runs one task, own deque first then stealing; false if none found
+		void worker_loop(std::size_t index);
+		void push(std::size_t index, std::function<void()> task);
+	public:
+		explicit thread_pool(std::size_t threads = 0); // zero means one thread per hardware core
+		~thread_pool();
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		std::size_t size() const { return workers.size(); }
+		void submit(std::function<void()> task); // fire-and-forget
+
+		void parallel_for(std::size_t count, std::size_t chunk, const std::function<void(std::size_t, std::size_t)>& body);
+		// calls body(begin, end) over [0, count) in pieces of at most chunk; the calling thread helps, sleeps once there is
+		// nothing left to take, and returns when every piece is done, rethrowing the first exception any piece threw
+	};
+}
+
+#endif
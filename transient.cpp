@@ -0,0 +1,302 @@
+#include "transient.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+namespace unit_namespace {
+
+	waveform waveform::step(double amplitude, double delay)
+	{
+		waveform w;
+		w.kind = shape::step; w.amplitude = amplitude; w.delay = delay;
+		return w;
+	}
+
+	waveform waveform::pulse(double amplitude, double delay, double rise, double width, double fall, double period)
+	{
+		waveform w;
+		w.kind = shape::pulse; w.amplitude = amplitude; w.delay = delay;
+		w.rise = rise; w.width = width; w.fall = fall; w.period = period;
+		return w;
+	}
+
+	waveform waveform::sine(double amplitude, double omega, double delay)
+	{
+		waveform w;
+		w.kind = shape::sine; w.amplitude = amplitude; w.omega = omega; w.delay = delay;
+		return w;
+	}
+
+	double waveform::value(double t) const
+	{
+		if (t <= delay) { return 0; }
+		double since = t - delay;
+		switch (kind) {
+		case shape::step: return amplitude;
+		case shape::sine: return amplitude * std::sin(omega * since);
+		case shape::pulse:
+			if (period > 0) { since = std::fmod(since, period); }
+			if (since < rise) { return amplitude * since / rise; }
+			since -= rise;
+			if (since < width) { return amplitude; }
+			since -= width;
+			if (since < fall) { return amplitude * (1 - since / fall); }
+			return 0;
+		}
+		return 0;
+	}
+
+	double waveform::next_breakpoint(double t) const
+	{
+		const double never = std::numeric_limits<double>::infinity();
+		if (t < delay) { return delay; }
+		if (kind != shape::pulse) { return never; }
+		double since = t - delay, start{ 0 };
+		if (period > 0) { start = std::floor(since / period) * period; }
+		const double corners[4]{ rise, rise + width, rise + width + fall, period };
+		for (int cycle = 0; cycle < 2; cycle++) { // the next cycle only matters when rounding puts t on this one's last corner
+			for (double corner : corners) {
+				double at = delay + start + cycle * period + corner;
+				if (at > t && corner > 0) { return at; }
+			}
+			if (!(period > 0)) { break; }
+		}
+		return never;
+	}
+
+	namespace {
+
+		class transient_system // the flattened tree with its companion models, and the solution at the last step
+		{
+		private:
+			std::size_t n;
+			std::vector<std::uint8_t> kinds;
+			std::vector<double> values;
+			std::vector<std::uint32_t> parent; // n for the root, which gives its contribution somewhere harmless
+			std::vector<std::uint8_t> in_series; // parent is a series circuit
+
+			// the per-step system: node k carries i = g v + J with J = a v_last + b i_last + s (sum over its members);
+			// each member adds m times its own J to that sum (m is 1/g in a series circuit, 1 in a parallel one)
+			std::vector<double> g, r, a, b, s, m;
+			std::vector<double> j, sum;
+			double step_size{ 0 };
+			integration_method step_method{ integration_method::trapezoidal };
+
+		public:
+			std::vector<double> voltage, current; // of every node at the last step; the state of each capacitor and inductor
+
+			explicit transient_system(const flat_view& circuit)
+				: n{ circuit.size }, kinds(circuit.kinds, circuit.kinds + circuit.size), values(circuit.characteristics, circuit.characteristics + circuit.size),
+				parent(circuit.size, static_cast<std::uint32_t>(circuit.size)), in_series(circuit.size, 0),
+				g(n), r(n), a(n), b(n), s(n), m(n), j(n), sum(n + 1), voltage(n), current(n)
+			{
+				if (n == 0) { throw std::invalid_argument("transient simulation needs a non-empty circuit"); }
+				std::vector<std::size_t> stack;
+				for (std::size_t k = 0; k < n; k++) {
+					unit_kind kind = static_cast<unit_kind>(kinds[k]);
+					if (kind != unit_kind::series && kind != unit_kind::parallel && !(values[k] > 0 && std::isfinite(values[k]))) {
+						throw std::invalid_argument("transient simulation needs every component value to be positive and finite");
+					}
+					if ((kind == unit_kind::series || kind == unit_kind::parallel) && circuit.arities[k] == 0) { // its G would be 1/0 or 0/0
+						throw std::invalid_argument("transient simulation needs every series and parallel circuit to have members");
+					}
+					std::size_t first = stack.size() - circuit.arities[k];
+					for (std::size_t i = first; i < stack.size(); i++) {
+						parent[stack[i]] = static_cast<std::uint32_t>(k);
+						in_series[stack[i]] = kind == unit_kind::series;
+					}
+					stack.resize(first);
+					stack.push_back(k);
+				}
+			}
+
+			std::size_t size() const { return n; }
+			bool is_state(std::size_t k) const { return kinds[k] == static_cast<std::uint8_t>(unit_kind::capacitor) || kinds[k] == static_cast<std::uint8_t>(unit_kind::inductor); }
+			double state(std::size_t k) const { return kinds[k] == static_cast<std::uint8_t>(unit_kind::capacitor) ? voltage[k] : current[k]; }
+
+			void set_step(double h, integration_method method) // works out g, r and the history coefficients; postorder, so members come first
+			{
+				if (h == step_size && method == step_method) { return; }
+				step_size = h; step_method = method;
+				bool trapezoidal = method == integration_method::trapezoidal;
+				std::fill(sum.begin(), sum.end(), 0.);
+				for (std::size_t k = 0; k < n; k++) {
+					switch (static_cast<unit_kind>(kinds[k])) {
+					case unit_kind::resistor: g[k] = 1 / values[k]; a[k] = 0; b[k] = 0; break;
+					case unit_kind::capacitor: // i = C dv/dt
+						g[k] = (trapezoidal ? 2 : 1) * values[k] / h; a[k] = -g[k]; b[k] = trapezoidal ? -1 : 0; break;
+					case unit_kind::inductor: // v = L di/dt
+						g[k] = h / ((trapezoidal ? 2 : 1) * values[k]); a[k] = trapezoidal ? g[k] : 0; b[k] = 1; break;
+					case unit_kind::parallel: g[k] = sum[k]; a[k] = 0; b[k] = 0; break;
+					case unit_kind::series: g[k] = 1 / sum[k]; a[k] = 0; b[k] = 0; break;
+					}
+					r[k] = 1 / g[k];
+					s[k] = static_cast<unit_kind>(kinds[k]) == unit_kind::series ? g[k] : 1;
+					m[k] = in_series[k] ? r[k] : 1;
+					sum[k] = 0;
+					sum[parent[k]] += in_series[k] ? r[k] : g[k]; // a series circuit adds resistances, a parallel one conductances
+				}
+				sum[n] = 0;
+			}
+
+			void advance(double source, drive_kind drive, transient_sample& out) // one step of the size last set
+			{
+				for (std::size_t k = 0; k < n; k++) { // up: each node's J from the last solution and its members' J
+					double jk = a[k] * voltage[k] + b[k] * current[k] + s[k] * sum[k];
+					sum[k] = 0;
+					j[k] = jk;
+					sum[parent[k]] += m[k] * jk;
+				}
+				sum[n] = 0;
+				std::size_t root = n - 1;
+				if (drive == drive_kind::voltage) { voltage[root] = source; current[root] = g[root] * source + j[root]; }
+				else { current[root] = source; voltage[root] = (source - j[root]) * r[root]; }
+				for (std::size_t k = root; k-- > 0;) { // down: a series member shares its parent's current, a parallel one its voltage
+					std::uint32_t p = parent[k];
+					if (in_series[k]) { current[k] = current[p]; voltage[k] = (current[k] - j[k]) * r[k]; }
+					else { voltage[k] = voltage[p]; current[k] = g[k] * voltage[k] + j[k]; }
+				}
+				out.voltage = voltage[root];
+				out.current = current[root];
+			}
+		};
+
+		class chunked_output
+		{
+		private:
+			const transient_sink& sink;
+			std::vector<transient_sample> buffer;
+			std::size_t capacity;
+		public:
+			chunked_output(const transient_sink& target, std::size_t chunk) : sink{ target }, capacity{ std::max<std::size_t>(chunk, 1) } { buffer.reserve(capacity); }
+			void add(const transient_sample& sample)
+			{
+				buffer.push_back(sample);
+				if (buffer.size() == capacity) { flush(); }
+			}
+			void flush()
+			{
+				if (!buffer.empty()) { sink(buffer.data(), buffer.size()); }
+				buffer.clear();
+			}
+		};
+
+		void check_options(const transient_options& o)
+		{
+			const waveform& w = o.source;
+			if (!std::isfinite(w.amplitude) || !(w.delay >= 0) || !std::isfinite(w.delay)) { throw std::invalid_argument("the source needs a finite amplitude and a delay of at least zero"); }
+			if (w.kind == waveform::shape::pulse) {
+				if (!(w.rise >= 0 && w.width >= 0 && w.fall >= 0 && w.period >= 0) || !std::isfinite(w.rise + w.width + w.fall + w.period)) {
+					throw std::invalid_argument("pulse times must be finite and not negative");
+				}
+				if (w.period > 0 && w.period < w.rise + w.width + w.fall) { throw std::invalid_argument("a pulse period must cover its rise, width and fall"); }
+			}
+			if (w.kind == waveform::shape::sine && !std::isfinite(w.omega)) { throw std::invalid_argument("the sine needs a finite omega"); }
+			if (!(o.stop_time > 0) || !std::isfinite(o.stop_time)) { throw std::invalid_argument("stop_time must be positive"); }
+			if (!(o.step > 0) || !std::isfinite(o.step)) { throw std::invalid_argument("step must be positive"); }
+			if (o.adaptive && !(o.relative_tolerance >= 0 && o.absolute_tolerance >= 0 && o.relative_tolerance + o.absolute_tolerance > 0)) {
+				throw std::invalid_argument("the tolerances must not be negative, and not both zero");
+			}
+			if (!(o.min_step >= 0)) { throw std::invalid_argument("min_step must not be negative"); }
+		}
+
+		transient_result fixed_steps(transient_system& system, const transient_options& o, chunked_output& out)
+		{
+			transient_result result;
+			result.smallest_step = result.largest_step = o.step;
+			std::size_t steps = static_cast<std::size_t>(std::ceil(o.stop_time / o.step * (1 - 1e-12)));
+			transient_sample sample{};
+			for (std::size_t k = 1; k <= std::max<std::size_t>(steps, 1); k++) {
+				system.set_step(o.step, k == 1 ? integration_method::backward_euler : o.method); // no work after the second step
+				sample.time = static_cast<double>(k) * o.step;
+				system.advance(o.source.value(sample.time), o.drive, sample);
+				out.add(sample);
+			}
+			result.steps = std::max<std::size_t>(steps, 1);
+			return result;
+		}
+
+		transient_result adaptive_steps(transient_system& system, const transient_options& o, chunked_output& out)
+		// step doubling: each step is taken once whole and once as two halves, and the difference between the two,
+		// scaled by the method's order, estimates the error of the halves, which are kept if it is small enough
+		{
+			transient_result result;
+			result.smallest_step = std::numeric_limits<double>::infinity();
+			double min_step = o.min_step > 0 ? o.min_step : o.step * 1e-9;
+			std::size_t n = system.size();
+			std::vector<double> start_voltage(n), start_current(n), whole(n);
+			std::vector<double> peak(n); // largest size each state has had, so the relative tolerance does not shrink to nothing at zero crossings
+			double t{ 0 }, h = o.step, corner = o.source.next_breakpoint(0);
+			bool after_corner{ true };
+			transient_sample sample{};
+			while (t < o.stop_time * (1 - 1e-12)) {
+				double limit = std::min(o.stop_time, corner) - t;
+				double step = std::min(h, limit);
+				bool reaches_corner = step == limit && corner <= o.stop_time;
+				integration_method method = after_corner ? integration_method::backward_euler : o.method;
+				double order_factor = method == integration_method::trapezoidal ? 3 : 1; // 2^order - 1
+
+				start_voltage = system.voltage; start_current = system.current;
+				system.set_step(step, method);
+				system.advance(o.source.value(t + step), o.drive, sample);
+				for (std::size_t k = 0; k < n; k++) { whole[k] = system.state(k); }
+				system.voltage = start_voltage; system.current = start_current;
+				system.set_step(step / 2, method);
+				system.advance(o.source.value(t + step / 2), o.drive, sample);
+				system.advance(o.source.value(t + step), o.drive, sample);
+
+				double error{ 0 };
+				for (std::size_t k = 0; k < n; k++) {
+					if (!system.is_state(k)) { continue; }
+					double x = system.state(k), allowed = o.absolute_tolerance + o.relative_tolerance * std::max({ peak[k], std::abs(x), std::abs(whole[k]) });
+					error = std::max(error, std::abs(x - whole[k]) / order_factor / allowed);
+				}
+				if (!(error <= 1) && step > min_step) { // rejected; NaN is rejected too
+					result.rejected++;
+					system.voltage = start_voltage; system.current = start_current;
+					h = std::max(min_step, step * (std::isfinite(error) ? std::max(0.2, 0.9 * std::cbrt(1 / error)) : 0.2));
+					continue;
+				}
+				for (std::size_t k = 0; k < n; k++) { if (system.is_state(k)) { peak[k] = std::max(peak[k], std::abs(system.state(k))); } }
+				t = reaches_corner ? corner : t + step; // exactly on the corner, so the next one is found after it
+				sample.time = t;
+				out.add(sample);
+				result.steps++;
+				result.smallest_step = std::min(result.smallest_step, step);
+				result.largest_step = std::max(result.largest_step, step);
+				after_corner = reaches_corner;
+				if (reaches_corner) { corner = o.source.next_breakpoint(t); }
+				h = std::min(o.step, step * (error > 0 ? std::min(2., 0.9 * std::cbrt(1 / error)) : 2.));
+			}
+			if (result.steps == 0) { result.smallest_step = 0; }
+			return result;
+		}
+	}
+
+	transient_result simulate_transient(const flat_view& circuit, const transient_options& options, const transient_sink& sink)
+	{
+		check_options(options);
+		transient_system system(circuit);
+		chunked_output out(sink, options.chunk);
+		out.add({ 0, 0, 0 }); // at rest
+		transient_result result = options.adaptive ? adaptive_steps(system, options, out) : fixed_steps(system, options, out);
+		out.flush();
+		return result;
+	}
+
+	transient_result simulate_transient(const unit& root, const transient_options& options, const transient_sink& sink)
+	{
+		flat_circuit flat(root);
+		return simulate_transient(flat.view(), options, sink);
+	}
+
+	std::vector<transient_sample> transient_response(const unit& root, const transient_options& options)
+	{
+		std::vector<transient_sample> samples;
+		simulate_transient(root, options, [&](const transient_sample* chunk, std::size_t count) { samples.insert(samples.end(), chunk, chunk + count); });
+		return samples;
+	}
+}
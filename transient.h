@@ -0,0 +1,79 @@
+// header file for transient (time-domain) simulation of a unit tree driven at its two terminals by a voltage or current
+// source. Each component is replaced at every step by its companion model, a conductance in parallel with a current
+// source set from the last step (trapezoidal rule, or backward Euler), so every node of the tree becomes a Norton
+// equivalent i = G v + J: a parallel circuit adds its members' G and J, and a series circuit adds their 1/G and J/G.
+// One step is then one pass up the flattened tree for the J values and one pass down it for every node's voltage and
+// current. The G values depend only on the step size, so with a fixed step they are worked out once.
+//
+// The circuit is at rest before t = 0 and every source is zero up to its delay. Samples of the terminal voltage and
+// current are handed to a sink a chunk at a time, so runs of millions of steps need no more memory than one chunk.
+#pragma once
+#ifndef transient_h
+#define transient_h
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include "unit_class.h"
+#include "flat_circuit.h"
+
+namespace unit_namespace {
+
+	enum class integration_method : unsigned char { trapezoidal, backward_euler };
+	enum class drive_kind : unsigned char { voltage, current }; // what the source at the terminals sets
+
+	struct waveform
+	{
+		enum class shape : unsigned char { step, pulse, sine };
+		shape kind{ shape::step };
+		double amplitude{ 1 }; // volts or amperes
+		double delay{ 0 }; // zero up to and including this time
+		double rise{ 0 }, width{ 0 }, fall{ 0 }; // pulse: linear edges either side of width at amplitude
+		double period{ 0 }; // pulse: repeats with this period; zero means once
+		double omega{ 0 }; // sine: amplitude sin(omega (t - delay))
+
+		static waveform step(double amplitude, double delay = 0);
+		static waveform pulse(double amplitude, double delay, double rise, double width, double fall, double period = 0);
+		static waveform sine(double amplitude, double omega, double delay = 0);
+
+		double value(double t) const;
+		double next_breakpoint(double t) const; // first time after t where the waveform has a corner; infinity if none
+	};
+
+	struct transient_options
+	{
+		waveform source;
+		drive_kind drive{ drive_kind::voltage };
+		double stop_time{ 1e-3 }; // seconds
+		double step{ 1e-6 }; // the fixed step; when adaptive, the first and largest step
+		bool adaptive{ false }; // chooses each step by step doubling and lands on every corner of the source
+		double relative_tolerance{ 1e-6 }, absolute_tolerance{ 1e-12 };
+		// adaptive: error allowed per step in each capacitor voltage and inductor current, relative to the largest it has been
+		double min_step{ 0 }; // adaptive: steps are not cut below this; zero means step * 1e-9
+		integration_method method{ integration_method::trapezoidal };
+		std::size_t chunk{ 4096 }; // samples handed to the sink at a time
+	};
+
+	struct transient_sample { double time, voltage, current; }; // at the terminals; current flows in at the first
+
+	using transient_sink = std::function<void(const transient_sample* samples, std::size_t count)>;
+
+	struct transient_result
+	{
+		std::size_t steps{ 0 }; // accepted steps; there is one more sample, at t = 0
+		std::size_t rejected{ 0 }; // adaptive steps retried with a smaller step
+		double smallest_step{ 0 }, largest_step{ 0 };
+	};
+
+	transient_result simulate_transient(const flat_view& circuit, const transient_options& options, const transient_sink& sink);
+	transient_result simulate_transient(const unit& root, const transient_options& options, const transient_sink& sink);
+	// with a fixed step the samples are at k * step up to the first at or past stop_time. The first step of a run, and
+	// when adaptive the first step after each corner of the source, uses backward Euler so a source that jumps is not
+	// averaged with the value before the jump. Throws std::invalid_argument if a component value is not positive and
+	// finite, a series or parallel circuit has no members, or the options are out of range
+
+	std::vector<transient_sample> transient_response(const unit& root, const transient_options& options);
+	// every sample in one vector, for short runs
+}
+
+#endif
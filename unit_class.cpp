@@ -1,178 +1,276 @@
-#include "unit_class.h"
-
-namespace unit_namespace {
-
-	std::map<std::string, std::string> make_identifier(std::string name, std::string measure)
-	{
-		std::map<std::string, std::string> identifier;
-		identifier.insert(std::make_pair("name", name));
-		identifier.insert(std::make_pair("measure", measure));
-		return identifier;
-	}
-
-	//unit class implementation
-	double unit::get_freq() const { return omega; }
-	void unit::set_freq(const double input) { omega = input; }
-	double unit::get_impedance_magnitude() const { return abs(this->get_impedance()); } // true for all units
-	double unit::get_phase() const { return arg(this->get_impedance()); } // true for all units - using standard complex library
-	std::map<std::string, std::string> unit::get_identifier() const { return identifier; };
-
-	// circuit class implementation
-
-	circuit::circuit(const circuit& other) { // copy constructor
-		for (const auto& unit_ptr : other.units) {
-			units.push_back(unit_ptr->clone());
-		}
-		identifier = other.identifier;
-	}
-	circuit::circuit(circuit&& other) noexcept {
-		units = std::move(other.units); other.units.clear(); identifier = std::move(other.identifier);
-	} //move constructor
-
-	circuit& circuit::operator=(const circuit& other) { //copy assignment operator
-		if (this != &other) {
-			units.clear();
-			for (const auto& unit_ptr : other.units) {
-				units.push_back(unit_ptr->clone());
-			}
-			identifier = other.identifier;
-		}
-		return *this;
-	}
-
-	circuit& circuit::operator=(circuit&& other) noexcept { //move assignment operator
-		if (this != &other) {
-			units = std::move(other.units);
-			other.units.clear();
-			identifier = std::move(other.identifier);
-		}
-		return *this;
-	}
-
-	void circuit::add_unit(std::unique_ptr<unit> input) { units.push_back(std::move(input)); }
-
-	void circuit::print_func(int level, bool full_output) // recursive function that uses the variable 'level' to give indentation of nesting
-	{
-		std::cout << identifier["name"];
-		if (full_output) {
-			std::cout << " with impendance magnitude " << this->get_impedance_magnitude() << " and phase " << this->get_phase();
-			std::cout << ". It has elements:" << std::endl;
-		}
-		else { std::cout << " with elements:" << std::endl; }
-		
-		std::vector<std::unique_ptr<unit>>::const_iterator iter;
-		for (iter = units.begin(); iter != units.end(); iter++)
-		{
-			std::cout << std::string(level, '-'); (*iter)->print_func(level + 1, full_output);
-		}
-		std::cout << "//////////end of circuit/////////////" << std::endl;
-	}
-
-	//parallel circuit implementation
-	parallel_circuit::parallel_circuit() { identifier = make_identifier("Parallel Circuit", "None"); } //default
-	parallel_circuit::parallel_circuit(std::vector<std::unique_ptr<unit>>&& us) //parameterised
-	{
-		units = (std::move(us)); identifier = make_identifier("Parallel Circuit", "None");
-	} //parameterised; using move as we have unique pointers
-
-	std::unique_ptr<unit> parallel_circuit::clone() const { return std::make_unique<parallel_circuit>(*this); }
-
-	std::complex<double> parallel_circuit::get_impedance() const {
-		std::vector<std::unique_ptr<unit>>::const_iterator iter; std::complex<double> sum;
-		for (iter = units.begin(); iter != units.end(); iter++)
-			sum += 1. / ((*iter)->get_impedance());
-		return 1. / sum;
-	}
-
-	//series circuit implementation
-	series_circuit::series_circuit() { identifier = make_identifier("Series Circuit", "None"); } //default
-	series_circuit::series_circuit(std::vector<std::unique_ptr<unit>>&& us)
-	{
-		units = (std::move(us)); identifier = make_identifier("Series Circuit", "None");
-	} //parameterised
-
-	std::unique_ptr<unit> series_circuit::clone() const { return std::make_unique<series_circuit>(*this); }
-
-	std::complex<double> series_circuit::get_impedance() const {
-		std::vector<std::unique_ptr<unit>>::const_iterator iter; std::complex<double> sum;
-		for (iter = units.begin(); iter != units.end(); iter++)
-			sum += (*iter)->get_impedance();
-		return sum;
-	}
-
-	// Inductor implementation
-	inductor::inductor() { characteristic = 0; identifier = make_identifier("Inductor", "H"); }
-	inductor::inductor(double c) { //param constructor
-		characteristic = 0;
-		if (c >= 0) { characteristic = c; }
-		else {
-			std::cout << "This characteristic must be greater than zero; zero value assigned" << std::endl;
-		}
-		identifier = make_identifier("Inductor", "H");
-	}
-
-	std::complex<double> inductor::get_impedance() const {
-		return std::complex<double>{ 0, characteristic* omega };
-	}
-
-	// Resistor implementation
-	resistor::resistor() { characteristic = 0; identifier = make_identifier("Resistor", "Ohms"); }
-	resistor::resistor(double c) {
-		characteristic = 0;
-		if (c >= 0) { characteristic = c; }
-		else {
-			std::cout << "This characteristic must be greater than zero; zero value assigned" << std::endl;
-		}
-		identifier = make_identifier("Resistor", "Ohms");
-	}
-
-	std::complex<double> resistor::get_impedance() const {
-		return std::complex<double>{ characteristic, 0 };
-	}
-
-	// Capacitor implementation
-
-	capacitor::capacitor() { characteristic = 0; identifier = make_identifier("Capacitor", "F"); }
-	capacitor::capacitor(double c) {
-		characteristic = 0;
-		if (c >= 0) { characteristic = c; }
-		else {
-			std::cout << "This characteristic must be greater than zero; zero value assigned" << std::endl;
-		}
-		identifier = make_identifier("Capacitor", "F");;
-	}
-
-	std::complex<double> capacitor::get_impedance() const {
-		return std::complex<double>{ 0, -1. / (characteristic * omega) };
-	}
-
-	double unit::omega = 0; // define static data member outside class
-
-	void print_list(std::vector<std::unique_ptr<unit>>& input)
-	{
-		int index{ 1 };
-		std::cout << "Current frequency is " << unit::omega << "Hz" << std::endl;
-		std::vector<std::unique_ptr<unit>>::const_iterator iter;
-		for (iter = input.begin(); iter != input.end(); iter++, index++)
-		{
-			std::cout << index << ". "; (*iter)->print_func(1, false);
-		}
-	}
-
-	std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c)
-	{
-		std::vector<std::unique_ptr<unit>> random_list;
-		srand(time(NULL)); // Seed the random number generator
-		int x; double y;
-		for (int i = 1; i <= size; i++) {
-			x = rand() % 3; // generate a random integer between 0 and 3 exclusive
-			y = b * static_cast<double>(rand()) / RAND_MAX; // generate a random double between 0 and b inclusive
-			if (x == 0) { random_list.push_back(std::move(std::make_unique<inductor>(y/1000000))); } // division included for physical reasons
-			if (x == 1) { random_list.push_back(std::move(std::make_unique<resistor>(y))); }
-			if (x == 2) { random_list.push_back(std::move(std::make_unique<capacitor>(y/1000000.))); } // division included for physical reasons
-		}
-		unit::omega = c * static_cast<double>(rand()) / RAND_MAX; // assigns omega to a random double between 0 and c inclusive
-		return random_list;
-	}
-}
-
+#include "unit_class.h"
+#include "counter_rng.h"
+
+#include <random>
+#include <iterator>
+
+namespace unit_namespace {
+
+	namespace { // one copy of each type's identifier for the whole program
+		const unit_info parallel_info{ "Parallel Circuit", "None" };
+		const unit_info series_info{ "Series Circuit", "None" };
+		const unit_info inductor_info{ "Inductor", "H" };
+		const unit_info resistor_info{ "Resistor", "Ohms" };
+		const unit_info capacitor_info{ "Capacitor", "F" };
+	}
+
+	std::map<std::string, std::string> make_identifier(std::string name, std::string measure)
+	{
+		std::map<std::string, std::string> identifier;
+		identifier.insert(std::make_pair("name", name));
+		identifier.insert(std::make_pair("measure", measure));
+		return identifier;
+	}
+
+	//impedance cache implementation
+	impedance_cache::impedance_cache() : omega{ std::numeric_limits<double>::quiet_NaN() } {} // NaN never matches
+
+	bool impedance_cache::lookup(double at_omega, std::complex<double>& z) const
+	{
+		unsigned before = sequence.load(std::memory_order_acquire);
+		if (before & 1) { return false; }
+		double w = omega.load(std::memory_order_relaxed), re = real.load(std::memory_order_relaxed), im = imag.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) != before || w != at_omega) { return false; } // torn read or other frequency
+		z = std::complex<double>{ re, im };
+		return true;
+	}
+
+	void impedance_cache::store(double at_omega, std::complex<double> z) const
+	{
+		unsigned before = sequence.load(std::memory_order_relaxed);
+		if ((before & 1) || !sequence.compare_exchange_strong(before, before + 1, std::memory_order_acquire)) { return; }
+		std::atomic_thread_fence(std::memory_order_release);
+		omega.store(at_omega, std::memory_order_relaxed); real.store(z.real(), std::memory_order_relaxed); imag.store(z.imag(), std::memory_order_relaxed);
+		sequence.store(before + 2, std::memory_order_release);
+	}
+
+	void impedance_cache::clear() const
+	{
+		unsigned before = sequence.load(std::memory_order_relaxed);
+		while ((before & 1) || !sequence.compare_exchange_weak(before, before + 1, std::memory_order_acquire)) {
+			before = sequence.load(std::memory_order_relaxed); // a store in progress must finish before it can be undone
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		omega.store(std::numeric_limits<double>::quiet_NaN(), std::memory_order_relaxed);
+		sequence.store(before + 2, std::memory_order_release);
+	}
+
+	//unit class implementation
+	void unit::invalidate_ancestors()
+	{
+		for (circuit* c = parent; c != nullptr; c = c->parent) { c->cache.clear(); }
+	}
+
+	double unit::get_freq() const { return default_omega.load(std::memory_order_relaxed); }
+	void unit::set_freq(const double input) { default_omega.store(input, std::memory_order_relaxed); }
+	std::complex<double> unit::get_impedance() const { return get_impedance(eval_context{ get_freq() }); }
+	double unit::get_impedance_magnitude() const { return abs(this->get_impedance()); } // true for all units
+	double unit::get_phase() const { return arg(this->get_impedance()); } // true for all units - using standard complex library
+	double unit::get_impedance_magnitude(const eval_context& context) const { return abs(this->get_impedance(context)); }
+	double unit::get_phase(const eval_context& context) const { return arg(this->get_impedance(context)); }
+	std::map<std::string, std::string> unit::get_identifier() const { return make_identifier(info->name, info->measure); };
+
+	// circuit class implementation
+
+	circuit::circuit(const circuit& other) : unit(other) { // copy constructor
+		node_pool::arena_scope scope(node_pool::in_arena() ? 0 : other.children_footprint()); // copied nodes share one allocation
+		units.reserve(other.units.size());
+		for (const auto& unit_ptr : other.units) {
+			units.push_back(unit_ptr->clone());
+		}
+		adopt_units();
+	}
+	circuit::circuit(circuit&& other) noexcept : unit(other) {
+		units = std::move(other.units); other.units.clear();
+		adopt_units(); other.cache.clear(); other.invalidate_ancestors(); // other is now empty, as after move assignment
+	} //move constructor
+
+	circuit& circuit::operator=(const circuit& other) { //copy assignment operator
+		if (this != &other) {
+			units.clear();
+			node_pool::arena_scope scope(node_pool::in_arena() ? 0 : other.children_footprint());
+			units.reserve(other.units.size());
+			for (const auto& unit_ptr : other.units) {
+				units.push_back(unit_ptr->clone());
+			}
+			info = other.info;
+			adopt_units(); cache.clear(); invalidate_ancestors();
+		}
+		return *this;
+	}
+
+	circuit& circuit::operator=(circuit&& other) noexcept { //move assignment operator
+		if (this != &other) {
+			units = std::move(other.units);
+			other.units.clear();
+			info = other.info;
+			adopt_units(); cache.clear(); invalidate_ancestors();
+			other.cache.clear(); other.invalidate_ancestors();
+		}
+		return *this;
+	}
+
+	void circuit::add_unit(std::unique_ptr<unit> input) {
+		input->parent = this; units.push_back(std::move(input));
+		cache.clear(); invalidate_ancestors();
+	}
+	void circuit::adopt_units() { for (auto& unit_ptr : units) { unit_ptr->parent = this; } }
+	const unit_list& circuit::get_units() const { return units; }
+	std::size_t circuit::children_footprint() const
+	{
+		std::size_t bytes = units.empty() ? 0 : node_pool::node_bytes(units.size() * sizeof(std::unique_ptr<unit>)); // a copy reserves exactly
+		for (const auto& unit_ptr : units) { bytes += unit_ptr->footprint(); }
+		return bytes;
+	}
+
+	void circuit::print_func(int level, bool full_output) // recursive function that uses the variable 'level' to give indentation of nesting
+	{
+		UNIT_TIME(print, "print_func"); UNIT_COUNT(print, get_kind());
+		std::cout << info->name;
+		if (full_output) {
+			std::cout << " with impendance magnitude " << this->get_impedance_magnitude() << " and phase " << this->get_phase();
+			std::cout << ". It has elements:\n";
+		}
+		else { std::cout << " with elements:\n"; }
+		
+		unit_list::const_iterator iter;
+		for (iter = units.begin(); iter != units.end(); iter++)
+		{
+			std::cout << std::string(level, '-'); (*iter)->print_func(level + 1, full_output);
+		}
+		std::cout << "//////////end of circuit/////////////\n";
+	}
+
+	//parallel circuit implementation
+	parallel_circuit::parallel_circuit() { info = &parallel_info; UNIT_COUNT(allocate, unit_kind::parallel); } //default
+	parallel_circuit::parallel_circuit(std::vector<std::unique_ptr<unit>>&& us) //parameterised
+	{
+		units.assign(std::make_move_iterator(us.begin()), std::make_move_iterator(us.end())); info = &parallel_info; adopt_units(); UNIT_COUNT(allocate, unit_kind::parallel);
+	} //parameterised; using move as we have unique pointers
+
+	std::unique_ptr<unit> parallel_circuit::clone() const {
+		UNIT_TIME(clone, "parallel_circuit::clone"); UNIT_COUNT(clone, unit_kind::parallel); UNIT_COUNT(allocate, unit_kind::parallel);
+		node_pool::arena_scope scope(node_pool::in_arena() ? 0 : footprint()); // the copy constructor then finds this open
+		return std::make_unique<parallel_circuit>(*this);
+	}
+
+	std::complex<double> parallel_circuit::get_impedance(const eval_context& context) const {
+		UNIT_TIME(evaluate, "parallel_circuit::get_impedance"); UNIT_COUNT(evaluate, unit_kind::parallel); UNIT_TRACK_SHAPE(units.size());
+		std::complex<double> cached;
+		if (cache.lookup(context.omega, cached)) { return cached; }
+		unit_list::const_iterator iter; std::complex<double> sum;
+		for (iter = units.begin(); iter != units.end(); iter++)
+			sum += 1. / ((*iter)->get_impedance(context));
+		cache.store(context.omega, 1. / sum);
+		return 1. / sum;
+	}
+
+	//series circuit implementation
+	series_circuit::series_circuit() { info = &series_info; UNIT_COUNT(allocate, unit_kind::series); } //default
+	series_circuit::series_circuit(std::vector<std::unique_ptr<unit>>&& us)
+	{
+		units.assign(std::make_move_iterator(us.begin()), std::make_move_iterator(us.end())); info = &series_info; adopt_units(); UNIT_COUNT(allocate, unit_kind::series);
+	} //parameterised
+
+	std::unique_ptr<unit> series_circuit::clone() const {
+		UNIT_TIME(clone, "series_circuit::clone"); UNIT_COUNT(clone, unit_kind::series); UNIT_COUNT(allocate, unit_kind::series);
+		node_pool::arena_scope scope(node_pool::in_arena() ? 0 : footprint());
+		return std::make_unique<series_circuit>(*this);
+	}
+
+	std::complex<double> series_circuit::get_impedance(const eval_context& context) const {
+		UNIT_TIME(evaluate, "series_circuit::get_impedance"); UNIT_COUNT(evaluate, unit_kind::series); UNIT_TRACK_SHAPE(units.size());
+		std::complex<double> cached;
+		if (cache.lookup(context.omega, cached)) { return cached; }
+		unit_list::const_iterator iter; std::complex<double> sum;
+		for (iter = units.begin(); iter != units.end(); iter++)
+			sum += (*iter)->get_impedance(context);
+		cache.store(context.omega, sum);
+		return sum;
+	}
+
+	// Inductor implementation
+	inductor::inductor() { characteristic = 0; info = &inductor_info; UNIT_COUNT(allocate, unit_kind::inductor); }
+	inductor::inductor(double c) { //param constructor
+		characteristic = 0;
+		if (c >= 0) { characteristic = c; }
+		else {
+			std::cout << "This characteristic must be greater than zero; zero value assigned" << std::endl;
+		}
+		info = &inductor_info; UNIT_COUNT(allocate, unit_kind::inductor);
+	}
+
+	std::complex<double> inductor::get_impedance(const eval_context& context) const {
+		UNIT_COUNT(evaluate, unit_kind::inductor);
+		return std::complex<double>{ 0, characteristic* context.omega };
+	}
+
+	// Resistor implementation
+	resistor::resistor() { characteristic = 0; info = &resistor_info; UNIT_COUNT(allocate, unit_kind::resistor); }
+	resistor::resistor(double c) {
+		characteristic = 0;
+		if (c >= 0) { characteristic = c; }
+		else {
+			std::cout << "This characteristic must be greater than zero; zero value assigned" << std::endl;
+		}
+		info = &resistor_info; UNIT_COUNT(allocate, unit_kind::resistor);
+	}
+
+	std::complex<double> resistor::get_impedance(const eval_context&) const {
+		UNIT_COUNT(evaluate, unit_kind::resistor);
+		return std::complex<double>{ characteristic, 0 };
+	}
+
+	// Capacitor implementation
+
+	capacitor::capacitor() { characteristic = 0; info = &capacitor_info; UNIT_COUNT(allocate, unit_kind::capacitor); }
+	capacitor::capacitor(double c) {
+		characteristic = 0;
+		if (c >= 0) { characteristic = c; }
+		else {
+			std::cout << "This characteristic must be greater than zero; zero value assigned" << std::endl;
+		}
+		info = &capacitor_info; UNIT_COUNT(allocate, unit_kind::capacitor);
+	}
+
+	std::complex<double> capacitor::get_impedance(const eval_context& context) const {
+		UNIT_COUNT(evaluate, unit_kind::capacitor);
+		return std::complex<double>{ 0, -1. / (characteristic * context.omega) };
+	}
+
+	std::atomic<double> unit::default_omega{ 0 }; // define static data member outside class
+
+	void print_list(std::vector<std::unique_ptr<unit>>& input)
+	{
+		int index{ 1 };
+		std::cout << "Current frequency is " << unit::default_omega.load() << "Hz\n";
+		std::vector<std::unique_ptr<unit>>::const_iterator iter;
+		for (iter = input.begin(); iter != input.end(); iter++, index++)
+		{
+			std::cout << index << ". "; (*iter)->print_func(1, false);
+		}
+	}
+
+	std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c)
+	{
+		return random_list_generator(size, b, c, (std::uint64_t{ std::random_device{}() } << 32) | std::random_device{}()); // fresh seed every call
+	}
+
+	std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c, std::uint64_t seed)
+	{
+		std::vector<std::unique_ptr<unit>> random_list;
+		int x; double y;
+		for (int i = 1; i <= size; i++) {
+			counter_stream random(seed, static_cast<std::uint64_t>(i)); // one stream per list entry, so entries do not depend on each other
+			x = static_cast<int>(random.next_below(3)); // generate a random integer between 0 and 3 exclusive, without the bias of rand() % 3
+			y = b * (1 - random.next_double()); // generate a random double in (0, b]
+			if (x == 0) { random_list.push_back(std::move(std::make_unique<inductor>(y/1000000))); } // division included for physical reasons
+			if (x == 1) { random_list.push_back(std::move(std::make_unique<resistor>(y))); }
+			if (x == 2) { random_list.push_back(std::move(std::make_unique<capacitor>(y/1000000.))); } // division included for physical reasons
+		}
+		unit::default_omega = c * (1 - counter_stream(seed, 0).next_double()); // assigns default frequency to a random double in (0, c]
+		return random_list;
+	}
+}
+
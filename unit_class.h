@@ -1,153 +1,240 @@
-// header file for the unit class hierachy. A unit refers to an overall combination of circuit elements; the elements
-// can be circuits themselves or just simple components, like an inductor.
-#pragma once
-#ifndef unit_class_h
-#define unit_class_h
-
-#include <iostream>
-#include <iomanip>
-#include <complex>
-#include <cmath>
-#include <vector>
-#include <map>
-#include <string>
-#include <cstdlib>
-#include <ctime>
-
-namespace unit_namespace {
-
-	std::map<std::string, std::string> make_identifier(std::string name, std::string measure);
-	//function makes the std::map identifier data-member without having to redefine key everytime
-
-	class unit //abstract base class
-	{
-	protected:
-		std::map<std::string, std::string> identifier; //identifier is used to differentiate between different components/circuits
-		static double omega; //frequency of the AC circuit
-
-		friend void print_list(std::vector<std::unique_ptr<unit>>& input); //needs to be friend function to access omega
-		// iterates through a list of base class pointers and uses print_func class members to print each element
-		friend std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c);
-		//Creates random list of base class pointers with characteristics between zero and a chosen value. 
-		//Also randomly sets frequency of unit class hierachy between zero and a chosen value.
-
-	public:
-		virtual ~unit() {}; // Need this!
-		double get_freq() const; // all units should be able to access and set the frequency
-		void set_freq(const double input);
-		double get_impedance_magnitude() const;
-		double get_phase() const;
-		virtual std::complex<double> get_impedance() const = 0; // pure virtual function
-		std::map<std::string, std::string> get_identifier() const;
-
-		virtual std::unique_ptr<unit> clone() const = 0; // pure virtual function - creates a copy of a derived class unique pointer
-
-		virtual void print_func(int level, bool full_output) = 0; // pure virtual function
-		// described at the particular derived class in question
-	};
-
-	class circuit : public unit // this inheritance scheme is used so we can put subcircuits in a circuit
-	{
-	protected:
-		std::vector<std::unique_ptr<unit>> units;
-	public:
-		circuit() = default; // include this to define copy and move even though we shall never instantiate a circuit class itself
-		~circuit() {} // virtual-ness is inherited
-		virtual std::unique_ptr<unit> const clone() { return nullptr; } // still needs to be defined in derived classes
-
-		circuit(const circuit& other); //copy constructor
-		circuit(circuit&& other) noexcept; //move constructor
-		circuit& operator=(const circuit& other); //copy assignment operator
-		circuit& operator=(circuit&& other) noexcept; //move assignment operator
-
-		void add_unit(std::unique_ptr<unit> input); // adds a unit to the circuit
-
-		void print_func(int level, bool full_output) override; // prints out all components inside its units data-member
-	};
-
-	class parallel_circuit : public circuit
-	{
-	public:
-		parallel_circuit(); //default
-		parallel_circuit(std::vector<std::unique_ptr<unit>>&& us); //parameterised
-		~parallel_circuit() {} // virtual-ness is inherited
-		std::unique_ptr<unit> clone() const override;
-
-		std::complex<double> get_impedance() const override;
-	};
-
-	class series_circuit : public circuit
-	{
-	public:
-		series_circuit(); //default
-		series_circuit(std::vector<std::unique_ptr<unit>>&& us); //parameterised
-		~series_circuit() {} // virtual-ness is inherited
-		std::unique_ptr<unit> clone() const override;
-
-		std::complex<double> get_impedance() const override;
-	};
-
-	template<typename T> //template implementation must be kept in header file
-	class component_impl : public unit {
-	protected:
-		double characteristic;
-	public:
-		component_impl() = default; // Compiler doesn't like this not included as gives warning characteristic is uninitialised. Doesn't really matter
-		~component_impl() {}
-
-		std::unique_ptr<unit> clone() const override {
-			return std::make_unique<T>(static_cast<const T&>(*this));
-		}
-
-		void set_characteristic(double c) {
-			if (c >= 0) { characteristic = c; }
-			else { std::cout << "This characteristic must be greater than zero; value unchanged" << std::endl; }
-			characteristic = c;
-		}
-		double get_characteristic() const { return characteristic; }
-
-		void print_func(int level, bool full_output) override { // prints out what the component is and its characteristic
-			std::cout << identifier["name"] << ": " << characteristic << " " << identifier["measure"];
-			if (full_output){
-				std::cout << "; impedance magnitude: " << this->get_impedance_magnitude() << ", phase: " << this->get_phase();
-			}
-			std::cout << std::endl;
-		}
-	};
-
-	class inductor : public component_impl<inductor> {
-	public:
-		inductor();
-		inductor(double c);
-		~inductor() {}
-
-		using component_impl<inductor>::component_impl;
-		std::complex<double> get_impedance() const override;
-	};
-
-	class resistor : public component_impl<resistor> {
-	public:
-		resistor();
-		resistor(double c);
-		~resistor() {}
-
-		using component_impl<resistor>::component_impl;
-		std::complex<double> get_impedance() const override;
-	};
-
-	class capacitor : public component_impl<capacitor> {
-	public:
-		capacitor();
-		capacitor(double c);
-		~capacitor() {}
-
-		using component_impl<capacitor>::component_impl;
-		std::complex<double> get_impedance() const override;
-	};
-
-	std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c); //had to be included again at bottom as otherwise get a function identifier not found error
-	void print_list(std::vector<std::unique_ptr<unit>>& input);
-}
-
-#endif
-
+// header file for the unit class hierachy. A unit refers to an overall combination of circuit elements; the elements
+// can be circuits themselves or just simple components, like an inductor.
+#pragma once
+#ifndef unit_class_h
+#define unit_class_h
+
+#include <iostream>
+#include <iomanip>
+#include <complex>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <memory>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include <atomic>
+#include <cstdint>
+#include "node_pool.h"
+#include "instrument.h"
+
+namespace unit_namespace {
+
+	enum class unit_kind : unsigned char { resistor, inductor, capacitor, series, parallel };
+	// lets code that walks a tree (e.g. the flattener) tell what a unit is without comparing identifier strings
+
+	struct eval_context // everything an impedance evaluation depends on besides the tree itself
+	{
+		double omega; //frequency of the AC circuit
+	};
+
+	struct unit_info // constant description shared by every unit of one type instead of a map stored in each instance
+	{
+		const char* name;
+		const char* measure;
+	};
+
+	std::map<std::string, std::string> make_identifier(std::string name, std::string measure);
+	//function makes the std::map returned by get_identifier without having to redefine key everytime
+
+	class circuit;
+
+	class impedance_cache // last impedance a circuit worked out; safe to read and fill from several threads at once
+	{
+	private:
+		mutable std::atomic<unsigned> sequence{ 0 }; // odd while an entry is being written
+		mutable std::atomic<double> omega;
+		mutable std::atomic<double> real{ 0 };
+		mutable std::atomic<double> imag{ 0 };
+	public:
+		impedance_cache(); // starts empty
+		bool lookup(double at_omega, std::complex<double>& z) const;
+		void store(double at_omega, std::complex<double> z) const; // skipped if another thread is mid-write
+		void clear() const;
+	};
+
+	class unit //abstract base class
+	{
+	protected:
+		const unit_info* info{ nullptr }; //identifier is used to differentiate between different components/circuits
+		circuit* parent{ nullptr }; // circuit this unit sits in, if any; used to invalidate cached impedances above it
+		friend class circuit; // sets parent when it takes ownership
+		static std::atomic<double> default_omega; //frequency used by the no-argument compatibility overloads only
+
+		friend void print_list(std::vector<std::unique_ptr<unit>>& input); //needs to be friend function to access default_omega
+		// iterates through a list of base class pointers and uses print_func class members to print each element
+		friend std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c);
+		friend std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c, std::uint64_t seed);
+		//Creates random list of base class pointers with characteristics between zero and a chosen value. 
+		//Also randomly sets frequency of unit class hierachy between zero and a chosen value.
+
+		void invalidate_ancestors(); // call after anything that changes this unit's impedance
+
+	public:
+		unit() = default;
+		unit(const unit& other) : info{ other.info } {} // a copy starts outside any circuit
+		unit& operator=(const unit& other) { info = other.info; invalidate_ancestors(); return *this; } // but stays where it is
+		virtual ~unit() {}; // Need this!
+		static void* operator new(std::size_t size) { return node_pool::allocate(size); } // units live in the node pool
+		static void operator delete(void* p) noexcept { node_pool::deallocate(p); }
+
+		double get_freq() const; // compatibility shim: gets and sets the default frequency shared by all units
+		void set_freq(const double input);
+		double get_impedance_magnitude() const;
+		double get_phase() const;
+		std::complex<double> get_impedance() const; // evaluates at the default frequency
+		double get_impedance_magnitude(const eval_context& context) const;
+		double get_phase(const eval_context& context) const;
+		virtual std::complex<double> get_impedance(const eval_context& context) const = 0; // pure virtual function
+		// reentrant: depends only on the tree and the context, so different threads can use different frequencies
+		std::map<std::string, std::string> get_identifier() const;
+		virtual unit_kind get_kind() const = 0; // pure virtual function
+
+		virtual std::unique_ptr<unit> clone() const = 0; // pure virtual function - creates a copy of a derived class unique pointer
+		virtual std::size_t footprint() const = 0; // arena bytes needed by this unit and everything inside it
+
+		virtual void print_func(int level, bool full_output) = 0; // pure virtual function
+		// described at the particular derived class in question
+	};
+
+	using unit_list = std::vector<std::unique_ptr<unit>, node_pool::allocator<std::unique_ptr<unit>>>; // a circuit's members
+
+	class circuit : public unit // this inheritance scheme is used so we can put subcircuits in a circuit
+	{
+	protected:
+		unit_list units; // in the node pool, so a clone's lists come from its arena block along with its nodes
+		impedance_cache cache; // re-evaluation after one component changes only redoes the path from it to the root
+
+		void adopt_units(); // points every sub-unit's parent at this circuit
+		friend class unit;
+	public:
+		circuit() = default; // include this to define copy and move even though we shall never instantiate a circuit class itself
+		~circuit() {} // virtual-ness is inherited
+		virtual std::unique_ptr<unit> const clone() { return nullptr; } // still needs to be defined in derived classes
+
+		circuit(const circuit& other); //copy constructor
+		circuit(circuit&& other) noexcept; //move constructor
+		circuit& operator=(const circuit& other); //copy assignment operator
+		circuit& operator=(circuit&& other) noexcept; //move assignment operator
+
+		void add_unit(std::unique_ptr<unit> input); // adds a unit to the circuit and invalidates cached impedances
+		const unit_list& get_units() const; // read-only access to the sub-units
+		std::size_t children_footprint() const; // arena bytes for the sub-units and the list holding them
+
+		void print_func(int level, bool full_output) override; // prints out all components inside its units data-member
+	};
+
+	class parallel_circuit : public circuit
+	{
+	public:
+		parallel_circuit(); //default
+		parallel_circuit(std::vector<std::unique_ptr<unit>>&& us); //parameterised
+		~parallel_circuit() {} // virtual-ness is inherited
+		parallel_circuit(const parallel_circuit& other) = default; // copy and move have to be spelled out because the destructor
+		parallel_circuit(parallel_circuit&& other) noexcept = default; // is user-declared, which otherwise turns moves into copies
+		parallel_circuit& operator=(const parallel_circuit& other) = default;
+		parallel_circuit& operator=(parallel_circuit&& other) noexcept = default;
+		std::unique_ptr<unit> clone() const override; // whole subtree goes into one arena block
+		std::size_t footprint() const override { return node_pool::node_bytes(sizeof(parallel_circuit)) + children_footprint(); }
+		unit_kind get_kind() const override { return unit_kind::parallel; }
+
+		using unit::get_impedance;
+		std::complex<double> get_impedance(const eval_context& context) const override;
+	};
+
+	class series_circuit : public circuit
+	{
+	public:
+		series_circuit(); //default
+		series_circuit(std::vector<std::unique_ptr<unit>>&& us); //parameterised
+		~series_circuit() {} // virtual-ness is inherited
+		series_circuit(const series_circuit& other) = default; // copy and move have to be spelled out because the destructor
+		series_circuit(series_circuit&& other) noexcept = default; // is user-declared, which otherwise turns moves into copies
+		series_circuit& operator=(const series_circuit& other) = default;
+		series_circuit& operator=(series_circuit&& other) noexcept = default;
+		std::unique_ptr<unit> clone() const override; // whole subtree goes into one arena block
+		std::size_t footprint() const override { return node_pool::node_bytes(sizeof(series_circuit)) + children_footprint(); }
+		unit_kind get_kind() const override { return unit_kind::series; }
+
+		using unit::get_impedance;
+		std::complex<double> get_impedance(const eval_context& context) const override;
+	};
+
+	template<typename T> //template implementation must be kept in header file
+	class component_impl : public unit {
+	protected:
+		double characteristic;
+	public:
+		component_impl() = default; // Compiler doesn't like this not included as gives warning characteristic is uninitialised. Doesn't really matter
+		~component_impl() {}
+
+		std::unique_ptr<unit> clone() const override {
+			UNIT_TIME(clone, "clone");
+			UNIT_COUNT(clone, this->get_kind()); UNIT_COUNT(allocate, this->get_kind());
+			return std::make_unique<T>(static_cast<const T&>(*this));
+		}
+		std::size_t footprint() const override { return node_pool::node_bytes(sizeof(T)); }
+
+		void set_characteristic(double c) {
+			if (c >= 0) { characteristic = c; }
+			else { std::cout << "This characteristic must be greater than zero; value unchanged" << std::endl; }
+			characteristic = c;
+			this->invalidate_ancestors();
+		}
+		double get_characteristic() const { return characteristic; }
+
+		void print_func(int level, bool full_output) override { // prints out what the component is and its characteristic
+			UNIT_TIME(print, "print_func"); UNIT_COUNT(print, this->get_kind());
+			std::cout << info->name << ": " << characteristic << " " << info->measure;
+			if (full_output){
+				std::cout << "; impedance magnitude: " << this->get_impedance_magnitude() << ", phase: " << this->get_phase();
+			}
+			std::cout << '\n'; // no flush per line; std::cin is tied to std::cout, so prompts still appear before input
+		}
+	};
+
+	class inductor : public component_impl<inductor> {
+	public:
+		inductor();
+		inductor(double c);
+		~inductor() {}
+
+		using component_impl<inductor>::component_impl;
+		unit_kind get_kind() const override { return unit_kind::inductor; }
+		using unit::get_impedance;
+		std::complex<double> get_impedance(const eval_context& context) const override;
+	};
+
+	class resistor : public component_impl<resistor> {
+	public:
+		resistor();
+		resistor(double c);
+		~resistor() {}
+
+		using component_impl<resistor>::component_impl;
+		unit_kind get_kind() const override { return unit_kind::resistor; }
+		using unit::get_impedance;
+		std::complex<double> get_impedance(const eval_context& context) const override;
+	};
+
+	class capacitor : public component_impl<capacitor> {
+	public:
+		capacitor();
+		capacitor(double c);
+		~capacitor() {}
+
+		using component_impl<capacitor>::component_impl;
+		unit_kind get_kind() const override { return unit_kind::capacitor; }
+		using unit::get_impedance;
+		std::complex<double> get_impedance(const eval_context& context) const override;
+	};
+
+	std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c); //had to be included again at bottom as otherwise get a function identifier not found error
+	std::vector<std::unique_ptr<unit>> random_list_generator(int size, int b, int c, std::uint64_t seed); // same list for the same seed
+	void print_list(std::vector<std::unique_ptr<unit>>& input);
+}
+
+#endif
+